@@ -29,6 +29,60 @@
    24th Mar 2017: software works pretty well more or less. There's still room for improvement in the object.cpp file. 
    A function that returns the averege colour of the pointed object should be implemented asap.
 
+   Options of the -SENSING mode:
+      -FILTERS filters.yml                           loads the filters instead of running the setup (the setup is
+                                                     run and saved there if the file can't be loaded)
+      -YUV                                           classifies the raw YUYV/NV12 frames of the camera without any
+                                                     colour conversion (see yuv.h)
+      -WORLD calib.yml                               gives the objects their position on the work plane in mm
+      -BGMODEL                                       learns the static clutter of the scene and ignores it (see
+                                                     bgmodel.h). Keep the objects out for the first second
+      -LIVE                                          reloads the -FILTERS file whenever it changes, without
+                                                     stopping; it may also set 'min_area' and 'morph_size'
+      -CONTROL port                                  takes filter and parameter updates on this UDP port (see
+                                                     liveconfig.h for the commands), from this machine only
+      -CONTROL_ADDRESS ip                            binds the -CONTROL port to this address instead of the
+                                                     loopback (0.0.0.0 for every interface): anyone reaching it
+                                                     can change the detection
+
+   Recording and replay (see record.h):
+      './CnRDetect -SENSING N -RECORD run.rec'       records frames, filters and detections of the session
+      './CnRDetect -REPLAY run.rec [-MAX] [-OUT new.rec]'
+                                                     feeds the recording through the pipeline, at the original
+                                                     speed or as fast as possible (-MAX), optionally recording
+                                                     the new detections
+      './CnRDetect -DIFF run.rec new.rec [tol]'      compares the detections of two recordings (exit code 1
+                                                     if they differ by more than tol pixels)
+
+   Benchmark on synthetic scenes with ground truth (see bench.h):
+      './CnRDetect -BENCH [-FRAMES n] [-VARIANT name] [-NOISE sigma] [-BLUR k] [-LIGHT drop] [-SPEED px]
+                  [-CLUTTER n]'
+                                                     sweeps resolution, number of objects and colours and prints
+                                                     fps, latency percentiles, recall, precision and centroid
+                                                     error as CSV. -CLUTTER adds n static strips to the scenes
+
+   Offline analysis of recorded footage on all the cores (see batch.h):
+      './CnRDetect -BATCH video|img_%04d.png filters.yml out.csv|out.rec [-THREADS n] [-WORLD calib.yml]'
+                                                     filters.yml as saved by '-SENSING N -FILTERS filters.yml'
+
+   Camera calibration for the positions in millimetres (see calib.h):
+      './CnRDetect -CALIBRATE calib.yml 9x6 25 plane.png view1.png view2.png ...'
+                                                     inner corners of the checkerboard and side of its squares
+                                                     in mm. The first image shows the board on the work plane
+
+   The sensor as a library, without any window (see visionsensor.h):
+      './CnRDetect -SENSOR filters.yml [-SOURCE video] [-RATE hz] [-YUV] [-BGMODEL] [-WORLD calib.yml] [-LIVE]
+                  [-CONTROL port [-CONTROL_ADDRESS ip]]'
+                                                     runs a VisionSensor and polls it from a loop at 'hz' (100 by
+                                                     default) as a robot controller would, printing the results.
+                                                     -LIVE, -CONTROL and -CONTROL_ADDRESS as for -SENSING
+
+   Any mode accepts '-TRACE trace.json' to record a timeline of the pipeline stages (see trace.h).
+
+   Check of the YUV path against the HSV one (see yuv.h):
+      './CnRDetect -YUVTEST file.yuv 640x480 YUYV|NV12 filters.yml'
+                                                     raw frames stored back to back (e.g. v4l2-ctl --stream-to)
+
 */
 
 #include <string>
@@ -36,22 +90,56 @@
 #include <opencv/highgui.h>
 #include <opencv/cv.h>
 #include "myLib.h"
+#include "record.h"
+#include "bench.h"
+#include "yuv.h"
+#include "trace.h"
+#include "batch.h"
+#include "calib.h"
+#include "visionsensor.h"
 
 using namespace std;
 using namespace cv;
 
+// returns the argument following 'option' (e.g. the file name after -RECORD), NULL if the option is missing
+static const char* GetOption(int argc, char* argv[], const char* option)
+{
+   for (int i = 1; i < argc - 1; i++)
+      if ( strcmp(argv[i], option) == 0 )
+         return argv[i+1];
+   return NULL;
+}
+
+static bool HasFlag(int argc, char* argv[], const char* flag)
+{
+   for (int i = 1; i < argc; i++)
+      if ( strcmp(argv[i], flag) == 0 )
+         return true;
+   return false;
+}
 
 int main(int argc, char* argv[])
 {
    int HowManyColours;
+   int result = 0;   // exit code of the modes that have one (-DIFF)
 
    // check what mode the user is adopting.
-   if (argc < 2 || ( strcmp(argv[1], "-DEBUG") != 0 && strcmp(argv[1], "-SENSING") != 0 ) )
+   if (argc < 2 || ( strcmp(argv[1], "-DEBUG") != 0 && strcmp(argv[1], "-SENSING") != 0 &&
+                     strcmp(argv[1], "-REPLAY") != 0 && strcmp(argv[1], "-DIFF") != 0 &&
+                     strcmp(argv[1], "-BENCH") != 0 && strcmp(argv[1], "-YUVTEST") != 0 &&
+                     strcmp(argv[1], "-BATCH") != 0 && strcmp(argv[1], "-CALIBRATE") != 0 &&
+                     strcmp(argv[1], "-SENSOR") != 0 ) )
    {
-      cout << "You have to call the program either in -DEBUG or -SENSING mode\n";
+      cout << "You have to call the program either in -DEBUG, -SENSING, -REPLAY, -DIFF, -BENCH, -YUVTEST, -BATCH, -CALIBRATE\n";
+      cout << "or -SENSOR mode\n";
       cout << "Exiting.\n";
       return -1;
    }
+   // -TRACE file.json works with every mode (see trace.h)
+   const char* tracePath = GetOption(argc, argv, "-TRACE");
+   if (tracePath != NULL)
+      TraceStart();
+
    if ( strcmp(argv[1], "-DEBUG") == 0 )
    {   
       DebugMode();   // argv[1] = -DEBUG => we enter debug mode
@@ -71,10 +159,192 @@ int main(int argc, char* argv[])
          return -1;
       }
       
+      SensingOptions options;
+      options.recordPath  = GetOption(argc, argv, "-RECORD");
+      options.filtersPath = GetOption(argc, argv, "-FILTERS");
+      options.yuv         = HasFlag(argc, argv, "-YUV");
+      options.worldPath   = GetOption(argc, argv, "-WORLD");
+      options.background  = HasFlag(argc, argv, "-BGMODEL");
+      options.live        = HasFlag(argc, argv, "-LIVE");
+      options.controlPort = GetOption(argc, argv, "-CONTROL") != NULL ? atoi(GetOption(argc, argv, "-CONTROL")) : 0;
+      options.controlAddress = GetOption(argc, argv, "-CONTROL_ADDRESS");
+
+      if (options.live && options.filtersPath == NULL)
+      {
+         cout << "-LIVE needs the -FILTERS file to watch\n";
+         return -1;
+      }
+
       HowManyColours = atoi(argv[2]);
-      SensingMode(HowManyColours);
+      SensingMode(HowManyColours, options);
+   }
+
+   else if ( strcmp(argv[1],"-REPLAY") == 0 )
+   {
+      if (argc == 2)
+      {
+         cout << "Declare the recording you want to replay\n";
+         cout << "Exiting.\n";
+         return -1;
+      }
+
+      ReplayMode(argv[2], HasFlag(argc, argv, "-MAX"), GetOption(argc, argv, "-OUT"));
+   }
+
+   else if ( strcmp(argv[1],"-DIFF") == 0 )
+   {
+      if (argc < 4)
+      {
+         cout << "Declare the two recordings you want to compare\n";
+         cout << "Exiting.\n";
+         return -1;
+      }
+
+      // tolerance on the centers, in pixels
+      result = DiffRecordings(argv[2], argv[3], argc > 4 ? atof(argv[4]) : 1.0) == 0 ? 0 : 1;
+   }
+
+   else if ( strcmp(argv[1],"-BENCH") == 0 )
+   {
+      SynthParams degradation;
+      const char* option;
+
+      if ( (option = GetOption(argc, argv, "-NOISE"))   != NULL )  degradation.noiseSigma = atof(option);
+      if ( (option = GetOption(argc, argv, "-BLUR"))    != NULL )  degradation.blurKernel = atoi(option);
+      if ( (option = GetOption(argc, argv, "-LIGHT"))   != NULL )  degradation.lighting   = atof(option);
+      if ( (option = GetOption(argc, argv, "-SPEED"))   != NULL )  degradation.speed      = atof(option);
+      if ( (option = GetOption(argc, argv, "-CLUTTER")) != NULL )  degradation.clutter    = atoi(option);
+
+      option = GetOption(argc, argv, "-FRAMES");
+      BenchMode(option != NULL ? atoi(option) : 30, GetOption(argc, argv, "-VARIANT"), degradation);
    }
 
+   else if ( strcmp(argv[1],"-YUVTEST") == 0 )
+   {
+      int width, height;
+      HSV** FiltersParams;
+
+      if ( argc < 6 || sscanf(argv[3], "%dx%d", &width, &height) != 2 ||
+           (strcmp(argv[4], "YUYV") != 0 && strcmp(argv[4], "NV12") != 0) )
+      {
+         cout << "Usage: -YUVTEST file.yuv WIDTHxHEIGHT YUYV|NV12 filters.yml\n";
+         cout << "Exiting.\n";
+         return -1;
+      }
+
+      if ( (FiltersParams = LoadFilters(argv[5], HowManyColours)) == NULL )
+      {
+         cout << "Not able to load the filters from " << argv[5] << "\n";
+         return -1;
+      }
+
+      YUVTestMode(argv[2], Size(width, height), strcmp(argv[4], "YUYV") == 0 ? YUV_FORMAT_YUYV : YUV_FORMAT_NV12,
+                  FiltersParams, HowManyColours);
+      FreeFilters(FiltersParams);
+   }
+
+   else if ( strcmp(argv[1],"-BATCH") == 0 )
+   {
+      HSV** FiltersParams;
+      const char* threads = GetOption(argc, argv, "-THREADS");
+      const char* world = GetOption(argc, argv, "-WORLD");
+      CameraCalibration calibration;
+      DetectParams params;
+
+      if (argc < 5)
+      {
+         cout << "Usage: -BATCH video|img_%04d.png filters.yml out.csv|out.rec [-THREADS n] [-WORLD calib.yml]\n";
+         cout << "Exiting.\n";
+         return -1;
+      }
+
+      if ( (FiltersParams = LoadFilters(argv[3], HowManyColours)) == NULL )
+      {
+         cout << "Not able to load the filters from " << argv[3] << "\n";
+         return -1;
+      }
+
+      if ( !LoadDetectParams(argv[3], params) )   // same settings as -SENSING and -SENSOR with this file
+      {
+         cout << "min_area or morph_size out of range in " << argv[3] << "\n";
+         FreeFilters(FiltersParams);
+         return -1;
+      }
+
+      if ( world != NULL && !calibration.load(world) )
+      {
+         cout << "Not able to load the calibration from " << world << "\n";
+         FreeFilters(FiltersParams);
+         return -1;
+      }
+
+      int frames = BatchMode(argv[2], FiltersParams, HowManyColours, argv[4], threads != NULL ? atoi(threads) : 0,
+                             world != NULL ? &calibration : NULL, params);
+      FreeFilters(FiltersParams);
+      if (frames < 0)
+         return -1;
+   }
+
+   else if ( strcmp(argv[1],"-CALIBRATE") == 0 )
+   {
+      int width, height;
+      vector<string> images;
+
+      if ( argc < 6 || sscanf(argv[3], "%dx%d", &width, &height) != 2 || atof(argv[4]) <= 0 )
+      {
+         cout << "Usage: -CALIBRATE calib.yml COLSxROWS square_mm plane.png view1.png ...\n";
+         cout << "Exiting.\n";
+         return -1;
+      }
+
+      for (int i = 5; i < argc; i++)
+         if ( strcmp(argv[i], "-TRACE") == 0 )
+            i++;
+         else
+            images.push_back(argv[i]);
+
+      if ( !CalibrateMode(argv[2], Size(width, height), atof(argv[4]), images) )
+         return -1;
+   }
+
+   else if ( strcmp(argv[1],"-SENSOR") == 0 )
+   {
+      SensorConfig config;
+      const char* rate = GetOption(argc, argv, "-RATE");
+
+      if (argc < 3)
+      {
+         cout << "Usage: -SENSOR filters.yml [-SOURCE video] [-RATE hz] [-YUV] [-BGMODEL] [-WORLD calib.yml] [-LIVE]\n";
+         cout << "       [-CONTROL port [-CONTROL_ADDRESS ip]]\n";
+         cout << "Exiting.\n";
+         return -1;
+      }
+
+      if ( (config.FiltersParams = LoadFilters(argv[2], config.HowManyColours)) == NULL )
+      {
+         cout << "Not able to load the filters from " << argv[2] << "\n";
+         return -1;
+      }
+      config.source     = GetOption(argc, argv, "-SOURCE");
+      config.yuv        = HasFlag(argc, argv, "-YUV");
+      config.background = HasFlag(argc, argv, "-BGMODEL");
+      config.worldPath  = GetOption(argc, argv, "-WORLD");
+      config.watchPath  = HasFlag(argc, argv, "-LIVE") ? argv[2] : NULL;
+      config.controlPort = GetOption(argc, argv, "-CONTROL") != NULL ? atoi(GetOption(argc, argv, "-CONTROL")) : 0;
+      config.controlAddress = GetOption(argc, argv, "-CONTROL_ADDRESS");
+      LoadDetectParams(argv[2], config.params);
+
+      SensorMode(config, rate != NULL ? atof(rate) : 100);
+      FreeFilters(config.FiltersParams);   // the sensor keeps its own copy
+   }
+
+
+   if (tracePath != NULL)
+   {
+      TraceStop();
+      if ( TraceWrite(tracePath) )
+         cout << "Timeline written in " << tracePath << " (open it with chrome://tracing or ui.perfetto.dev)\n";
+   }
 
-   return 0;
+   return result;
 }
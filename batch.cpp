@@ -0,0 +1,259 @@
+/*
+   Offline analysis of recorded footage, using all the cores. See batch.h.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <opencv/highgui.h>
+#include <opencv/cv.h>
+#include "batch.h"
+#include "record.h"
+#include "trace.h"
+
+using namespace std;
+using namespace cv;
+
+// A frame in flight. Slot n % size of the ring holds frame n
+struct BatchJob
+{
+   Mat frame;
+   int64_t timestampUs;
+   vector<vector<Object> > targets;
+   bool done;
+};
+
+// Shared state of the reader, the workers and the writer. Everything is protected by 'lock'
+struct BatchQueue
+{
+   mutex lock;
+   condition_variable readable, processed, writable;   // for the workers, the writer and the reader
+
+   vector<BatchJob> ring;
+   int64_t nextRead, nextWork, nextWrite;
+   bool endOfInput;
+
+   HSV** FiltersParams;
+   int HowManyColours;
+   const CameraCalibration* calibration;   // NULL: positions in pixels only
+   DetectParams params;
+   int64_t busyUs;   // time spent detecting, summed over the workers
+};
+
+//*********************************************************************************************************************
+static void BatchWorker(BatchQueue* q)
+{
+   DetectWorkspace workspace;
+   vector<Object> targets[q->HowManyColours];
+
+   workspace.params = q->params;
+
+   TraceSetThreadName("batch worker");
+
+   while (true)
+   {
+      int64_t n;
+
+      {
+         unique_lock<mutex> guard(q->lock);
+         while (q->nextWork == q->nextRead && !q->endOfInput)
+            q->readable.wait(guard);
+         if (q->nextWork == q->nextRead)   // end of input and nothing left
+            return;
+         n = q->nextWork++;
+      }
+
+      // the slot is ours until we mark it as done: no lock needed
+      BatchJob &job = q->ring[n % q->ring.size()];
+      int64_t t0 = NowMicroseconds();
+
+      TraceSetFrame(n);
+      DetectObjects(job.frame, q->FiltersParams, q->HowManyColours, targets, workspace);
+      if (q->calibration != NULL)
+      {
+         TRACE_SPAN("toWorld");
+         q->calibration->mapObjects(targets, q->HowManyColours);
+      }
+      for (int i = 0; i < q->HowManyColours; i++)
+         job.targets[i].swap(targets[i]);
+
+      int64_t busy = NowMicroseconds() - t0;
+
+      {
+         lock_guard<mutex> guard(q->lock);
+         job.done = true;
+         q->busyUs += busy;
+      }
+      q->processed.notify_one();
+   }
+}
+
+static void WriteCSV(FILE* file, int64_t n, const BatchJob &job)
+{
+   for (size_t i = 0; i < job.targets.size(); i++)
+      for (size_t j = 0; j < job.targets[i].size(); j++)
+      {
+         const Object &o = job.targets[i][j];
+
+         fprintf(file, "%lld,%lld,%d,%.2f,%.2f,%.2f,%.2f,%.2f,%d,%.3f", (long long)n, (long long)job.timestampUs,
+                 (int)i, o.getCenter().x, o.getCenter().y, o.getAngle(), o.getSize().width, o.getSize().height,
+                 (int)o.getShape(), o.getShapeConfidence());
+         if (o.isMapped())
+            fprintf(file, ",%.2f,%.2f,%.2f\n", o.getWorldCenter().x, o.getWorldCenter().y, o.getWorldAngle());
+         else
+            fprintf(file, ",,,\n");
+      }
+}
+
+// Writes the frames in order as they get processed
+static void BatchWriter(BatchQueue* q, FILE* csv, Recorder* recorder)
+{
+   TraceSetThreadName("batch writer");
+
+   while (true)
+   {
+      int64_t n;
+
+      {
+         unique_lock<mutex> guard(q->lock);
+         while ( !(q->nextWrite < q->nextRead && q->ring[q->nextWrite % q->ring.size()].done) &&
+                 !(q->endOfInput && q->nextWrite == q->nextRead) )
+            q->processed.wait(guard);
+         if (q->nextWrite == q->nextRead)
+            return;
+         n = q->nextWrite;
+      }
+
+      BatchJob &job = q->ring[n % q->ring.size()];
+
+      if (csv != NULL)
+         WriteCSV(csv, n, job);
+      else
+         recorder->write(n, job.timestampUs, Mat(), q->FiltersParams, q->HowManyColours, &job.targets[0], q->params);
+
+      {
+         lock_guard<mutex> guard(q->lock);
+         job.frame.release();
+         q->nextWrite++;
+      }
+      q->writable.notify_one();
+   }
+}
+//*********************************************************************************************************************
+
+//*********************************************************************************************************************
+int BatchMode(const char* input, HSV** FiltersParams, int HowManyColours, const char* output, int threads,
+              const CameraCalibration* calibration, const DetectParams &params)
+{
+   VideoCapture capture(input);
+   BatchQueue q;
+   FILE* csv = NULL;
+   Recorder recorder;
+   size_t length = strlen(output);
+   vector<thread> workers;
+
+   if ( !capture.isOpened() )
+   {
+      cout << "Not able to open " << input << endl;
+      return -1;
+   }
+
+   if (length > 4 && strcmp(output + length - 4, ".rec") == 0)
+   {
+      if ( !recorder.open(output, REC_ENCODING_NONE) )
+      {
+         cout << "Not able to open " << output << endl;
+         return -1;
+      }
+   }
+   else
+   {
+      if ( (csv = fopen(output, "w")) == NULL )
+      {
+         cout << "Not able to open " << output << endl;
+         return -1;
+      }
+      fprintf(csv, "frame,timestamp_us,colour,x,y,angle,width,height,shape,shape_confidence,world_x_mm,world_y_mm,world_angle\n");
+   }
+
+   if (threads <= 0)
+      threads = max(1, (int)thread::hardware_concurrency());
+
+   // the parallelism is across frames: OpenCV's own threads would only compete with the workers
+   setNumThreads(1);
+
+   q.ring.resize(threads*BATCH_FRAMES_PER_THREAD);
+   for (size_t k = 0; k < q.ring.size(); k++)
+      q.ring[k].targets.resize(HowManyColours);
+   q.nextRead = q.nextWork = q.nextWrite = 0;
+   q.endOfInput = false;
+   q.FiltersParams = FiltersParams;
+   q.HowManyColours = HowManyColours;
+   q.calibration = calibration;
+   q.params = params;
+   q.busyUs = 0;
+
+   int64_t start = NowMicroseconds();
+
+   for (int t = 0; t < threads; t++)
+      workers.push_back( thread(BatchWorker, &q) );
+   thread writer(BatchWriter, &q, csv, &recorder);
+
+   // this thread reads the frames
+   TraceSetThreadName("batch reader");
+   while (true)
+   {
+      Mat frame;
+      int64_t n;
+
+      {
+         unique_lock<mutex> guard(q.lock);
+         while (q.nextRead - q.nextWrite >= (int64_t)q.ring.size())
+            q.writable.wait(guard);
+         n = q.nextRead;
+      }
+
+      {
+         TraceSetFrame(n);
+         TRACE_SPAN("read");
+         if ( !capture.read(frame) || frame.empty() )
+            break;
+      }
+
+      {
+         lock_guard<mutex> guard(q.lock);
+         BatchJob &job = q.ring[n % q.ring.size()];
+         job.frame = frame;
+         job.timestampUs = (int64_t)(capture.get(CV_CAP_PROP_POS_MSEC)*1000);
+         job.done = false;
+         q.nextRead++;
+      }
+      q.readable.notify_one();
+   }
+
+   {
+      lock_guard<mutex> guard(q.lock);
+      q.endOfInput = true;
+   }
+   q.readable.notify_all();
+   q.processed.notify_all();
+
+   for (int t = 0; t < threads; t++)
+      workers[t].join();
+   writer.join();
+
+   int64_t wall = NowMicroseconds() - start;
+
+   if (csv != NULL)
+      fclose(csv);
+   recorder.close();
+
+   cout << q.nextWrite << " frames in " << wall/1e6 << " s (" << (wall > 0 ? q.nextWrite*1e6/wall : 0) << " fps) with "
+        << threads << " workers, average parallelism " << (wall > 0 ? (double)q.busyUs/wall : 0) << endl;
+
+   return q.nextWrite;
+}
+//*********************************************************************************************************************
@@ -0,0 +1,26 @@
+/*
+   Offline analysis of recorded footage, using all the cores.
+
+   The frames of a video (or of an image sequence such as 'img_%04d.png') are read in order by one
+   thread, processed in parallel by a pool of workers, each with its own DetectWorkspace, and
+   written back in order by a writer thread. At most BATCH_FRAMES_PER_THREAD frames per worker are
+   in flight, so memory does not grow with the length of the footage.
+
+   The detections go to a CSV file (one line per object) or, if the output ends in '.rec', to a
+   detections-only recording (see record.h) that can be compared with -DIFF. With a camera calibration
+   (see calib.h) the workers also map the objects on the work plane.
+*/
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "myLib.h"
+#include "calib.h"
+
+#define BATCH_FRAMES_PER_THREAD 4
+
+// threads <= 0 means one worker per core, calibration may be NULL. Returns the number of frames processed, -1 on errors
+int BatchMode(const char* input, HSV** FiltersParams, int HowManyColours, const char* output, int threads,
+              const CameraCalibration* calibration = NULL, const DetectParams &params = DetectParams());
+
+#endif
@@ -0,0 +1,271 @@
+/*
+   End-to-end benchmark of the detection pipeline on synthetic scenes. See bench.h.
+*/
+
+#include <math.h>
+#include <string.h>
+#include <iostream>
+#include <algorithm>
+#include "bench.h"
+#include "record.h"
+#include "trace.h"
+#include "bgmodel.h"
+#include "kernels.h"
+
+using namespace std;
+using namespace cv;
+
+static BackgroundModel background;   // cleared by BenchPoint() for every new scene
+
+static void DetectObjectsWith(DetectKernel kernel, BackgroundModel* model, const Mat &src, HSV** FiltersParams,
+                              int HowManyColours, vector<Object> targets[])
+{
+   static DetectWorkspace workspace;   // kept across the frames, as SensingMode() and the batch workers do
+
+   workspace.kernel = kernel;
+   workspace.background = model;
+   workspace.params.maxObjects = BENCH_MAX_OBJECTS;   // the scaling with the object count is measured
+   DetectObjects(src, FiltersParams, HowManyColours, targets, workspace);
+}
+
+static void DetectSpecialised(const Mat &src, HSV** FiltersParams, int HowManyColours, vector<Object> targets[])
+{
+   DetectObjectsWith(DETECT_SPECIALISED, NULL, src, FiltersParams, HowManyColours, targets);
+}
+
+static void DetectPacked(const Mat &src, HSV** FiltersParams, int HowManyColours, vector<Object> targets[])
+{
+   DetectObjectsWith(DETECT_PACKED, NULL, src, FiltersParams, HowManyColours, targets);
+}
+
+static void DetectGeneric(const Mat &src, HSV** FiltersParams, int HowManyColours, vector<Object> targets[])
+{
+   DetectObjectsWith(DETECT_GENERIC, NULL, src, FiltersParams, HowManyColours, targets);
+}
+
+static void DetectBackground(const Mat &src, HSV** FiltersParams, int HowManyColours, vector<Object> targets[])
+{
+   DetectObjectsWith(DETECT_SPECIALISED, &background, src, FiltersParams, HowManyColours, targets);
+}
+
+// Every variant of the pipeline that should be compared is listed here
+static const PipelineVariant variants[] =
+{
+   { "hsv",         DetectSpecialised, DETECT_SPECIALISED, 0 },   // what DetectObjects() does by default
+   { "hsv-packed",  DetectPacked,      DETECT_PACKED,      0 },
+   { "hsv-generic", DetectGeneric,     DETECT_GENERIC,     0 },
+   { "hsv-bg",      DetectBackground,  DETECT_SPECIALISED, BG_LEARN_FRAMES },
+};
+static const int numVariants = sizeof(variants)/sizeof(variants[0]);
+
+// the classification DetectObjects() ends up running for the variant: without a kernel it falls back on
+// the generic path
+static const char* KernelTaken(const PipelineVariant &variant, int HowManyColours)
+{
+   MaskLayout layout = variant.kernel == DETECT_PACKED ? MASK_PACKED : MASK_SEPARATE;
+
+   if (variant.kernel == DETECT_GENERIC || SelectHSVKernel(HowManyColours, layout) == NULL)
+      return "generic";
+   return layout == MASK_PACKED ? "packed" : "specialised";
+}
+
+// empty CSV field for an undefined ratio
+static void PrintRatio(double value)
+{
+   if ( !isnan(value) )
+      cout << value;
+}
+
+static double Percentile(vector<double> &sorted, double q)
+{
+   if (sorted.empty())
+      return 0;
+   return sorted[ min(sorted.size() - 1, (size_t)(q*sorted.size())) ];
+}
+
+//*********************************************************************************************************************
+BenchResult BenchPoint(const SynthParams &params, const PipelineVariant &variant, int frames)
+{
+   SynthScene scene(params);
+   HSV** FiltersParams = scene.filters();
+   int C = min(max(params.numColours, 1), SYNTH_MAX_COLOURS);
+   vector<Object> targets[C];
+   vector<double> latency;
+   Mat frame;
+   double errorSum = 0, angleErrorSum = 0, busy = 0;
+   int angleCount = 0, rectangles = 0;
+   int matched = 0, truthCount = 0, detectedCount = 0, falsePositives = 0, tooSmall = 0, blanked = 0;
+   BenchResult result;
+
+   background.clear();
+
+   // 2 warm up frames, not measured, after those of the empty scene
+   for (int n = -2 - variant.learnFrames; n < frames; n++)
+   {
+      TraceSetFrame(n);
+      scene.render(frame, n >= -2);
+
+      int64_t t0 = NowMicroseconds();
+      variant.detect(frame, FiltersParams, C, targets);
+      int64_t t1 = NowMicroseconds();
+
+      if (n < 0)
+         continue;
+
+      latency.push_back((t1 - t0)/1000.0);
+      busy += t1 - t0;
+
+      // greedy matching, colour by colour: a detection matches the nearest unmatched object of its colour
+      // if it falls inside it
+      const vector<SynthObject> &truth = scene.truth();
+      vector<bool> used(truth.size(), false);
+
+      for (int i = 0; i < C; i++)
+         for (size_t j = 0; j < targets[i].size(); j++)
+         {
+            Point2f d = targets[i][j].getCenter();
+            int best = -1;
+            double bestDist = 1e9;
+
+            for (size_t k = 0; k < truth.size(); k++)
+            {
+               if (used[k] || truth[k].colour != i)
+                  continue;
+               double dx = d.x - truth[k].center.x, dy = d.y - truth[k].center.y;
+               double dist = sqrt(dx*dx + dy*dy);
+               if (dist < bestDist && dist < 0.5*min(truth[k].size.width, truth[k].size.height))
+               {
+                  best = k;
+                  bestDist = dist;
+               }
+            }
+
+            detectedCount++;
+            if (best < 0)
+               falsePositives++;
+            else
+            {
+               used[best] = true;
+               if (truth[best].size.area() > MIN_OBJECT_AREA)
+               {
+                  matched++;
+                  errorSum += bestDist;
+                  if (targets[i][j].getShape() == SHAPE_RECTANGLE)
+                     rectangles++;
+
+                  // the orientation of a square is not defined
+                  if (truth[best].size.height < 0.8*truth[best].size.width)
+                  {
+                     double e = fmod(fabs(targets[i][j].getAngle() - truth[best].angle), 180.0);
+                     angleErrorSum += min(e, 180 - e);
+                     angleCount++;
+                  }
+               }
+            }
+         }
+
+      // objects below the minimum area are discarded by analyzeContours() on purpose: they do not count
+      for (size_t k = 0; k < truth.size(); k++)
+         if (truth[k].size.area() > MIN_OBJECT_AREA)
+            truthCount++;
+         else
+            tooSmall++;
+
+      // a colour with too many blobs is still dropped whole by analyzeContours() (see bench.h)
+      for (int i = 0; i < C; i++)
+      {
+         int objects = 0;
+
+         for (size_t k = 0; k < truth.size(); k++)
+            if (truth[k].colour == i)
+               objects++;
+         if (targets[i].empty() && objects >= BENCH_MAX_OBJECTS)
+            blanked++;
+      }
+   }
+
+   sort(latency.begin(), latency.end());
+
+   result.fps       = busy > 0 ? frames*1e6/busy : 0;
+   result.p50       = Percentile(latency, 0.50);
+   result.p90       = Percentile(latency, 0.90);
+   result.p99       = Percentile(latency, 0.99);
+   result.worst     = latency.empty() ? 0 : latency.back();
+   result.recall    = truthCount > 0 ? (double)matched/truthCount : NAN;
+   result.precision = detectedCount > 0 ? 1 - (double)falsePositives/detectedCount : NAN;
+   result.centerError   = matched > 0 ? errorSum/matched : 0;
+   result.angleError    = angleCount > 0 ? angleErrorSum/angleCount : 0;
+   result.rectangleRate = matched > 0 ? (double)rectangles/matched : 0;
+   result.truthCount    = frames > 0 ? truthCount/frames : 0;
+   result.detectedCount = frames > 0 ? detectedCount/frames : 0;
+   result.tooSmall      = frames > 0 ? tooSmall/frames : 0;
+   result.blanked       = frames > 0 ? blanked/frames : 0;
+
+   FreeFilters(FiltersParams);
+   return result;
+}
+//*********************************************************************************************************************
+
+//*********************************************************************************************************************
+static bool HasDetectableObjects(const SynthParams &params)
+{
+   SynthScene scene(params);
+   const vector<SynthObject> &truth = scene.truth();
+
+   for (size_t k = 0; k < truth.size(); k++)
+      if (truth[k].size.area() > MIN_OBJECT_AREA)
+         return true;
+   return false;
+}
+
+// Sweeps resolution, number of objects and number of colours and prints one CSV line per point and variant.
+// 'degradation' carries noise, blur, lighting and speed, the other fields are overwritten by the sweep.
+void BenchMode(int frames, const char* variantName, const SynthParams &degradation)
+{
+   const Size resolutions[] = { Size(640, 480), Size(1280, 720), Size(1920, 1080), Size(3840, 2160) };
+   const int objectCounts[] = { 1, 10, 100, 1000 };
+   const int colourCounts[] = { 1, 2, 4, 8, 16 };
+
+   cout << "variant,width,height,objects,colours,fps,p50_ms,p90_ms,p99_ms,max_ms,"
+        << "recall,precision,center_err_px,angle_err_deg,rect_rate,truth,detected,too_small,blanked,kernel" << endl;
+
+   for (int r = 0; r < 4; r++)
+      for (int k = 0; k < 4; k++)
+         for (int c = 0; c < 5; c++)
+         {
+            SynthParams params = degradation;
+
+            if (colourCounts[c] > objectCounts[k])   // some colours would have no object at all
+               continue;
+
+            params.width      = resolutions[r].width;
+            params.height     = resolutions[r].height;
+            params.numObjects = objectCounts[k];
+            params.numColours = colourCounts[c];
+
+            // the cells of the grid are too small for any object to reach MIN_OBJECT_AREA: skipped
+            if ( !HasDetectableObjects(params) )
+               continue;
+
+            for (int v = 0; v < numVariants; v++)
+            {
+               if (variantName != NULL && strcmp(variantName, variants[v].name) != 0)
+                  continue;
+
+               BenchResult res = BenchPoint(params, variants[v], frames);
+
+               cout << variants[v].name << "," << params.width << "," << params.height << ","
+                    << params.numObjects << "," << params.numColours << ","
+                    << res.fps << "," << res.p50 << "," << res.p90 << "," << res.p99 << "," << res.worst << ",";
+               PrintRatio(res.recall);
+               cout << ",";
+               PrintRatio(res.precision);
+               cout << "," << res.centerError << "," << res.angleError << "," << res.rectangleRate << ","
+                    << res.truthCount << "," << res.detectedCount << "," << res.tooSmall << "," << res.blanked << ","
+                    << KernelTaken(variants[v], params.numColours) << endl;
+            }
+         }
+
+   return;
+}
+//*********************************************************************************************************************
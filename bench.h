@@ -0,0 +1,63 @@
+/*
+   End-to-end benchmark of the detection pipeline on synthetic scenes (see synth.h).
+
+   For every point of the sweep (resolution x number of objects x number of colours) a scene is
+   rendered frame after frame and fed to each pipeline variant. Only the variant is timed, the
+   rendering is not. The detections are matched against the ground truth to get recall, precision
+   and the centroid error, so that a faster variant can be checked for accuracy losses. With static
+   clutter in the scene (-CLUTTER) the detected count and the precision show how much of it gets
+   through to the blob analysis.
+
+   analyzeContours() returns nothing for a colour whose mask holds DetectParams::maxObjects contours or
+   more (a noisy filter, in the sensor). With the default MAX_NUM_OBJECTS the 100 and 1000 object points
+   would time that early return, so the bench raises it to BENCH_MAX_OBJECTS. The 'blanked' column
+   counts the colours still over it (colours per frame with no detection and at least that many objects
+   in the scene), their objects count against the recall.
+
+   The points where every object is below MIN_OBJECT_AREA (1000 objects up to 1280x720) are skipped:
+   nothing there can be detected on purpose. Recall and precision are left empty when there was nothing
+   to find or nothing was detected.
+
+   The 'kernel' column tells the classification that actually ran: SelectHSVKernel() has nothing for
+   more than KERNEL_MAX_COLOURS colours, nor on CPUs without SSSE3/NEON (see HSVKernelTarget()), and the
+   variants asking for a kernel then run the generic path, i.e. measure the same thing as hsv-generic.
+*/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <vector>
+#include <opencv/highgui.h>
+#include <opencv/cv.h>
+#include "myLib.h"
+#include "synth.h"
+
+#define BENCH_MAX_OBJECTS 100000   // DetectParams::maxObjects of the bench, above every point of the sweep
+
+// A pipeline variant has the same signature as DetectObjects()
+typedef void (*DetectFunction)(const cv::Mat &src, HSV** FiltersParams, int HowManyColours, std::vector<Object> targets[]);
+
+struct PipelineVariant
+{
+   const char* name;
+   DetectFunction detect;
+   DetectKernel kernel;   // classification asked for (see kernels.h)
+   int learnFrames;       // frames of the empty scene shown before the measure (for background models)
+};
+
+struct BenchResult
+{
+   double fps;
+   double p50, p90, p99, worst;   // latency percentiles, milliseconds
+   double recall, precision;      // NAN when there was nothing to find / nothing was detected
+   double centerError;            // mean distance between matched centers, pixels
+   double angleError;             // mean orientation error of the matched (clearly elongated) objects, degrees
+   double rectangleRate;          // fraction of the matched objects classified as rectangles
+   int truthCount, detectedCount, tooSmall;   // tooSmall: ground truth objects below MIN_OBJECT_AREA
+   int blanked;                   // colours over the maxObjects limit of analyzeContours(), see above
+};
+
+BenchResult BenchPoint(const SynthParams &params, const PipelineVariant &variant, int frames);
+void BenchMode(int frames, const char* variantName, const SynthParams &degradation);
+
+#endif
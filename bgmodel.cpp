@@ -0,0 +1,119 @@
+/*
+   Background model of the colour masks. See bgmodel.h.
+*/
+
+#include <string.h>
+#include <algorithm>
+#include "bgmodel.h"
+
+using namespace std;
+using namespace cv;
+
+#define BG_FULL 65535   // occupancy of a cell touched in every frame
+
+BackgroundModel::BackgroundModel(void)
+{
+   clear();
+}
+
+void BackgroundModel::clear()
+{
+   occupancy.clear();
+   size = Size(0, 0);
+   frames = 0;
+}
+
+//*********************************************************************************************************************
+void BackgroundModel::beginFrame(Size size, int HowManyColours)
+{
+   if (size != this->size || HowManyColours != (int)occupancy.size())
+   {
+      Size grid((size.width + BG_CELL - 1)/BG_CELL, (size.height + BG_CELL - 1)/BG_CELL);
+
+      occupancy.resize(HowManyColours);
+      for (int i = 0; i < HowManyColours; i++)
+         occupancy[i] = Mat::zeros(grid, CV_16UC1);
+      this->size = size;
+      frames = 0;
+   }
+
+   frames++;
+   return;
+}
+
+void BackgroundModel::apply(int colour, Mat &mask)
+{
+   Mat &occ = occupancy[colour];
+   double rate = learning() ? 1.0/frames : BG_RATE;   // plain average while learning
+
+   // touched: any pixel of the cell in the mask. The rows of a band of cells are OR-ed first, a pass
+   // that the compiler vectorises
+   band.create(1, mask.cols, CV_8UC1);
+   touched.create(occ.size(), CV_8UC1);
+   for (int cy = 0; cy < occ.rows; cy++)
+   {
+      uchar* b = band.ptr<uchar>(0);
+      uchar* t = touched.ptr<uchar>(cy);
+      int r1 = std::min(mask.rows, (cy + 1)*BG_CELL);
+
+      memcpy(b, mask.ptr<uchar>(cy*BG_CELL), mask.cols);
+      for (int r = cy*BG_CELL + 1; r < r1; r++)
+      {
+         const uchar* p = mask.ptr<uchar>(r);
+
+         for (int x = 0; x < mask.cols; x++)
+            b[x] |= p[x];
+      }
+
+      for (int cx = 0; cx < occ.cols; cx++)
+      {
+         uchar any = 0;
+
+         for (int x = cx*BG_CELL; x < std::min(mask.cols, (cx + 1)*BG_CELL); x++)
+            any |= b[x];
+         t[cx] = any != 0 ? 255 : 0;
+      }
+   }
+
+   touched.convertTo(touched16, CV_16UC1, BG_FULL/255);
+   addWeighted(occ, 1 - rate, touched16, rate, 0, occ);
+
+   if (learning())
+      return;
+
+   // clear the static cells: the cost grows with the static area only
+   compare(occ, BG_STATIC*BG_FULL, cells, CMP_GE);
+   for (int cy = 0; cy < cells.rows; cy++)
+   {
+      const uchar* c = cells.ptr<uchar>(cy);
+      int r1 = std::min(mask.rows, (cy + 1)*BG_CELL);
+
+      for (int cx = 0; cx < cells.cols; cx++)
+         if (c[cx] != 0)
+            for (int r = cy*BG_CELL; r < r1; r++)
+               memset(mask.ptr<uchar>(r) + cx*BG_CELL, 0, std::min(BG_CELL, mask.cols - cx*BG_CELL));
+   }
+
+   return;
+}
+
+void BackgroundModel::relearn(int colour)
+{
+   if (colour < 0 || colour >= (int)occupancy.size())   // nothing learned yet
+      return;
+
+   // at BG_RATE an object that stays still is absorbed again after the usual ~700 frames
+   occupancy[colour].setTo(0);
+}
+//*********************************************************************************************************************
+
+double BackgroundModel::staticFraction(int colour) const
+{
+   Mat cells;
+
+   if (colour < 0 || colour >= (int)occupancy.size())
+      return 0;
+
+   compare(occupancy[colour], BG_STATIC*BG_FULL, cells, CMP_GE);
+   return (double)countNonZero(cells)/cells.total();
+}
@@ -0,0 +1,58 @@
+/*
+   Background model of the colour masks, to suppress the static clutter of the cell (fixtures, tape
+   marks, painted parts) that falls inside a colour filter and would show up as objects in every frame.
+
+   The frame is divided in cells of BG_CELL x BG_CELL pixels. For every colour and every cell the model
+   keeps the running average of "the mask of this colour touched the cell" on 16 bits (8 would round
+   the slow updates away), i.e. one bit per pixel per colour. A cell touched in most of the recent
+   frames (BG_STATIC) is static and its pixels are cleared from the mask before the blob analysis.
+
+   The first BG_LEARN_FRAMES frames are a learning phase (plain average, nothing is cleared): the cell
+   should be empty of objects meanwhile. Afterwards the model keeps learning slowly (BG_RATE), so new
+   clutter is absorbed after a while, but so is an object that stays still for long: with the default
+   rate about 700 frames, ~25 s at 30 fps.
+
+   relearn() forgets what was learned for a colour: its mask means something else once its filter
+   changed, and the cells learned with the old one would clear the new objects. The colour then learns
+   at the same slow rate, not with a new learning phase: the scene is in use, and the objects in view
+   would be absorbed after BG_LEARN_FRAMES frames only.
+*/
+
+#ifndef BGMODEL_H
+#define BGMODEL_H
+
+#include <vector>
+#include <opencv/highgui.h>
+#include <opencv/cv.h>
+
+#define BG_CELL          4      // side of a cell in pixels
+#define BG_LEARN_FRAMES  30
+#define BG_RATE          (1.0/512)   // weight of a new frame after the learning phase
+#define BG_STATIC        0.75   // occupancy above which a cell is static (fraction of the recent frames)
+
+class BackgroundModel
+{
+   public:
+      BackgroundModel(void);
+
+      void clear();
+      // call once per frame, before apply(). The model starts over if the size of the frames or the
+      // number of colours changes
+      void beginFrame(cv::Size size, int HowManyColours);
+      // learns from the mask (0/255) of the given colour and clears its static cells
+      void apply(int colour, cv::Mat &mask);
+      // forgets what was learned for the colour, nothing is cleared from its mask until it learned again
+      void relearn(int colour);
+
+      bool learning() const { return frames <= BG_LEARN_FRAMES; }
+      int colours() const { return occupancy.size(); }
+      double staticFraction(int colour) const;   // fraction of the frame cleared for the colour
+
+   private:
+      std::vector<cv::Mat> occupancy;   // one per colour, CV_16UC1 (0..65535), one pixel per cell
+      cv::Mat band, touched, touched16, cells;   // scratch
+      cv::Size size;
+      int frames;
+};
+
+#endif
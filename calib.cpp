@@ -0,0 +1,183 @@
+/*
+   Camera-to-world mapping of the detections. See calib.h.
+*/
+
+#include <math.h>
+#include <iostream>
+#include "calib.h"
+
+using namespace std;
+using namespace cv;
+
+CameraCalibration::CameraCalibration(void) : rms(0), planeRms(0)
+{
+}
+
+//*********************************************************************************************************************
+bool CameraCalibration::calibrate(const vector<string> &images, Size board, float square)
+{
+   vector<vector<Point3f> > objectPoints;
+   vector<vector<Point2f> > imagePoints;
+   vector<Point3f> board3D;
+   vector<Point2f> board2D, normalised, mapped;
+   vector<Mat> rvecs, tvecs;
+
+   for (int r = 0; r < board.height; r++)
+      for (int c = 0; c < board.width; c++)
+      {
+         board3D.push_back( Point3f(c*square, r*square, 0) );
+         board2D.push_back( Point2f(c*square, r*square) );
+      }
+
+   for (size_t i = 0; i < images.size(); i++)
+   {
+      Mat gray = imread(images[i], CV_LOAD_IMAGE_GRAYSCALE);
+      vector<Point2f> corners;
+
+      if ( gray.empty() || (!imagePoints.empty() && gray.size() != size) ||
+           !findChessboardCorners(gray, board, corners, CV_CALIB_CB_ADAPTIVE_THRESH | CV_CALIB_CB_NORMALIZE_IMAGE) )
+      {
+         cout << "No " << board.width << "x" << board.height << " board found in " << images[i] << endl;
+         if (i == 0)   // without the plane there is nothing to map to
+            return false;
+         continue;
+      }
+
+      cornerSubPix(gray, corners, Size(11, 11), Size(-1, -1), TermCriteria(CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 30, 0.01));
+      size = gray.size();
+      imagePoints.push_back(corners);
+      objectPoints.push_back(board3D);
+   }
+
+   if (imagePoints.size() < CALIB_MIN_VIEWS)
+   {
+      cout << "The board was found in " << imagePoints.size() << " images, at least " << CALIB_MIN_VIEWS << " are needed" << endl;
+      return false;
+   }
+
+   rms = calibrateCamera(objectPoints, imagePoints, size, cameraMatrix, distCoeffs, rvecs, tvecs);
+
+   // the plane: all the corners of the first image are good points, plain least squares is enough
+   undistortPoints(imagePoints[0], normalised, cameraMatrix, distCoeffs);
+   homography = findHomography(normalised, board2D, 0);
+   if (homography.empty())
+      return false;
+
+   // how far from the real corners the mapping puts them
+   mapped = imagePoints[0];
+   toWorld(mapped);
+   planeRms = 0;
+   for (size_t k = 0; k < mapped.size(); k++)
+   {
+      Point2f d = mapped[k] - board2D[k];
+      planeRms += d.x*d.x + d.y*d.y;
+   }
+   planeRms = sqrt(planeRms/mapped.size());
+
+   return true;
+}
+//*********************************************************************************************************************
+
+//*********************************************************************************************************************
+bool CameraCalibration::save(const char* path) const
+{
+   FileStorage fs(path, FileStorage::WRITE);
+
+   if ( !fs.isOpened() )
+      return false;
+
+   fs << "image_width" << size.width;
+   fs << "image_height" << size.height;
+   fs << "camera_matrix" << cameraMatrix;
+   fs << "distortion" << distCoeffs;
+   fs << "plane_homography" << homography;
+   fs << "reprojection_error" << rms;
+   fs << "plane_error_mm" << planeRms;
+
+   return true;
+}
+
+bool CameraCalibration::load(const char* path)
+{
+   FileStorage fs(path, FileStorage::READ);
+
+   if ( !fs.isOpened() )
+      return false;
+
+   size = Size( (int)fs["image_width"], (int)fs["image_height"] );
+   fs["camera_matrix"] >> cameraMatrix;
+   fs["distortion"] >> distCoeffs;
+   fs["plane_homography"] >> homography;
+   rms      = (double)fs["reprojection_error"];
+   planeRms = (double)fs["plane_error_mm"];
+
+   if (cameraMatrix.empty() || homography.empty())
+   {
+      homography = Mat();
+      return false;
+   }
+   return true;
+}
+//*********************************************************************************************************************
+
+//*********************************************************************************************************************
+void CameraCalibration::toWorld(vector<Point2f> &points) const
+{
+   vector<Point2f> normalised;
+
+   if (points.empty())
+      return;
+
+   undistortPoints(points, normalised, cameraMatrix, distCoeffs);
+   perspectiveTransform(normalised, points, homography);
+   return;
+}
+
+void CameraCalibration::mapObjects(vector<Object> targets[], int HowManyColours) const
+{
+   vector<Point2f> points;
+   Point2f corners[4];
+
+   // 5 points per object: center, then the corners
+   for (int i = 0; i < HowManyColours; i++)
+      for (size_t j = 0; j < targets[i].size(); j++)
+      {
+         points.push_back(targets[i][j].getCenter());
+         targets[i][j].getCorners(corners);
+         points.insert(points.end(), corners, corners + 4);
+      }
+
+   toWorld(points);
+
+   for (int i = 0, p = 0; i < HowManyColours; i++)
+      for (size_t j = 0; j < targets[i].size(); j++, p += 5)
+         targets[i][j].setWorld(points[p], &points[p + 1]);
+
+   return;
+}
+//*********************************************************************************************************************
+
+//*********************************************************************************************************************
+bool CalibrateMode(const char* path, Size board, float square, const vector<string> &images)
+{
+   CameraCalibration calibration;
+
+   if ( !calibration.calibrate(images, board, square) )
+   {
+      cout << "Calibration failed." << endl;
+      return false;
+   }
+
+   cout << "Reprojection error " << calibration.error() << " px, error on the plane "
+        << calibration.planeError() << " mm" << endl;
+
+   if ( !calibration.save(path) )
+   {
+      cout << "Not able to write " << path << endl;
+      return false;
+   }
+   cout << "Calibration saved in " << path << endl;
+
+   return true;
+}
+//*********************************************************************************************************************
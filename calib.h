@@ -0,0 +1,61 @@
+/*
+   Camera-to-world mapping of the detections.
+
+   The calibration is done once, offline, on images of a checkerboard read from files. It gives the
+   intrinsics and the lens distortion of the camera and, from the first image, where the board lies
+   flat on the work plane, the homography between the (undistorted) image and the plane. The first
+   inner corner of the board in that image is the origin of the world, its rows and columns are the
+   x and y axes, the unit is the millimetre.
+
+   At run time only the points of the objects are mapped (center and the 4 corners of the rotated
+   rectangle): they are undistorted with undistortPoints() and moved on the plane with the homography.
+   The frames are never remapped, so the cost grows with the number of objects, not of pixels.
+
+      './CnRDetect -CALIBRATE calib.yml 9x6 25 plane.png view1.png view2.png ...'
+      './CnRDetect -SENSING N -WORLD calib.yml'
+*/
+
+#ifndef CALIB_H
+#define CALIB_H
+
+#include <string>
+#include <vector>
+#include <opencv/highgui.h>
+#include <opencv/cv.h>
+#include "object.h"
+
+#define CALIB_MIN_VIEWS 3   // calibrateCamera() needs several orientations of the board to separate the intrinsics
+
+class CameraCalibration
+{
+   public:
+      CameraCalibration(void);
+
+      // 'board' is the number of inner corners per row and per column, 'square' the side of a square in mm.
+      // images[0] must show the board on the work plane
+      bool calibrate(const std::vector<std::string> &images, cv::Size board, float square);
+
+      bool save(const char* path) const;
+      bool load(const char* path);
+
+      bool empty() const { return homography.empty(); }
+      cv::Size imageSize() const { return size; }       // the frames to map must have this size
+      double error() const { return rms; }               // reprojection error of the calibration, in pixels
+      double planeError() const { return planeRms; }     // error on the corners of the plane image, in mm
+
+      // pixels -> millimetres on the plane, in place
+      void toWorld(std::vector<cv::Point2f> &points) const;
+      // fills the world position of all the objects, with a single call to toWorld()
+      void mapObjects(std::vector<Object> targets[], int HowManyColours) const;
+
+   private:
+      cv::Mat cameraMatrix, distCoeffs;
+      cv::Mat homography;   // normalised undistorted image coordinates -> plane
+      cv::Size size;
+      double rms, planeRms;
+};
+
+// runs the calibration and saves it in 'path'. Returns false if it fails
+bool CalibrateMode(const char* path, cv::Size board, float square, const std::vector<std::string> &images);
+
+#endif
@@ -0,0 +1,136 @@
+/*
+   3D HSV histogram with a summed-volume table. See hsvhist.h.
+*/
+
+#include "hsvhist.h"
+
+using namespace std;
+using namespace cv;
+
+HSVHistogram::HSVHistogram(void)
+{
+   clear();
+}
+
+void HSVHistogram::clear()
+{
+   hist.assign((size_t)HIST_H_BINS*HIST_SV_BINS*HIST_SV_BINS, 0);
+   table.assign((size_t)(HIST_H_BINS + 1)*(HIST_SV_BINS + 1)*(HIST_SV_BINS + 1), 0);
+   pixels = 0;
+}
+
+//*********************************************************************************************************************
+void HSVHistogram::add(const Mat &hsv)
+{
+   for (int r = 0; r < hsv.rows; r++)
+   {
+      const uchar* p = hsv.ptr<uchar>(r);
+
+      for (int c = 0; c < hsv.cols; c++, p += 3)
+         hist[ ((size_t)min((int)p[0], MAX_HUE)*HIST_SV_BINS + (p[1] >> HIST_SV_SHIFT))*HIST_SV_BINS + (p[2] >> HIST_SV_SHIFT) ]++;
+   }
+   pixels += hsv.total();
+
+   // table(h, s, v) = sum of hist over [0, h) x [0, s) x [0, v), built one axis at a time
+   for (int h = 1; h <= HIST_H_BINS; h++)
+      for (int s = 1; s <= HIST_SV_BINS; s++)
+      {
+         uint32_t run = 0;
+         const uint32_t* src = &hist[((size_t)(h - 1)*HIST_SV_BINS + (s - 1))*HIST_SV_BINS];
+
+         for (int v = 1; v <= HIST_SV_BINS; v++)
+         {
+            run += src[v - 1];
+            at(h, s, v) = run;
+         }
+      }
+
+   for (int h = 1; h <= HIST_H_BINS; h++)
+      for (int s = 2; s <= HIST_SV_BINS; s++)
+         for (int v = 1; v <= HIST_SV_BINS; v++)
+            at(h, s, v) += at(h, s - 1, v);
+
+   for (int h = 2; h <= HIST_H_BINS; h++)
+      for (int s = 1; s <= HIST_SV_BINS; s++)
+         for (int v = 1; v <= HIST_SV_BINS; v++)
+            at(h, s, v) += at(h - 1, s, v);
+}
+//*********************************************************************************************************************
+
+//*********************************************************************************************************************
+uint64_t HSVHistogram::sum(int h0, int h1, int s0, int s1, int v0, int v1) const
+{
+   if (h0 > h1 || s0 > s1 || v0 > v1)
+      return 0;
+
+   // inclusion-exclusion over the 8 corners of the box
+   h1++;  s1++;  v1++;
+   return (int64_t)at(h1, s1, v1) - at(h0, s1, v1) - at(h1, s0, v1) - at(h1, s1, v0)
+        + at(h0, s0, v1) + at(h0, s1, v0) + at(h1, s0, v0) - at(h0, s0, v0);
+}
+
+uint64_t HSVHistogram::count(const HSV &min, const HSV &max) const
+{
+   return sum(std::max(min.hue, 0), std::min(max.hue, MAX_HUE),
+              std::max(min.sat, 0) >> HIST_SV_SHIFT, std::min(max.sat, MAX_SAT) >> HIST_SV_SHIFT,
+              std::max(min.val, 0) >> HIST_SV_SHIFT, std::min(max.val, MAX_VAL) >> HIST_SV_SHIFT);
+}
+
+double HSVHistogram::coverage(const HSV &min, const HSV &max) const
+{
+   return pixels > 0 ? (double)count(min, max)/pixels : 0;
+}
+//*********************************************************************************************************************
+
+//*********************************************************************************************************************
+void HSVHistogram::tighten(HSV &min, HSV &max, double keep) const
+{
+   // work on bins: lo[k], hi[k] for hue, sat, val
+   int lo[3] = { std::max(min.hue, 0), std::max(min.sat, 0) >> HIST_SV_SHIFT, std::max(min.val, 0) >> HIST_SV_SHIFT };
+   int hi[3] = { std::min(max.hue, MAX_HUE), std::min(max.sat, MAX_SAT) >> HIST_SV_SHIFT, std::min(max.val, MAX_VAL) >> HIST_SV_SHIFT };
+   uint64_t target = (uint64_t)(keep*sum(lo[0], hi[0], lo[1], hi[1], lo[2], hi[2]));
+
+   // every shrink would keep "enough" of nothing and the box would collapse to a single bin
+   if (target == 0)
+      return;
+
+   while (true)
+   {
+      int bestAxis = -1, bestSide = 0;
+      uint64_t bestCount = 0;
+
+      // try moving each of the 6 faces one bin inwards
+      for (int k = 0; k < 3; k++)
+         for (int side = 0; side < 2; side++)
+         {
+            int l[3] = { lo[0], lo[1], lo[2] }, h[3] = { hi[0], hi[1], hi[2] };
+
+            if (lo[k] >= hi[k])
+               continue;
+            if (side == 0) l[k]++;
+            else           h[k]--;
+
+            uint64_t n = sum(l[0], h[0], l[1], h[1], l[2], h[2]);
+            if (n >= target && (bestAxis < 0 || n > bestCount))
+            {
+               bestAxis  = k;
+               bestSide  = side;
+               bestCount = n;
+            }
+         }
+
+      if (bestAxis < 0)
+         break;
+
+      if (bestSide == 0) lo[bestAxis]++;
+      else               hi[bestAxis]--;
+   }
+
+   min.hue = lo[0];
+   max.hue = hi[0];
+   min.sat = lo[1] << HIST_SV_SHIFT;
+   max.sat = std::min(((hi[1] + 1) << HIST_SV_SHIFT) - 1, MAX_SAT);
+   min.val = lo[2] << HIST_SV_SHIFT;
+   max.val = std::min(((hi[2] + 1) << HIST_SV_SHIFT) - 1, MAX_VAL);
+}
+//*********************************************************************************************************************
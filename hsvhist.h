@@ -0,0 +1,53 @@
+/*
+   3D HSV histogram with a summed-volume table (3D prefix sums) for the calibration of the filters.
+
+   Once the snapshots of the scene are added, the number of pixels inside any HSV box (i.e. what
+   inRange() would let through, before the morphological operations) comes back in O(1) with 8
+   lookups, whatever the size of the frames. Hue is binned exactly (180 bins), saturation and
+   value are binned by 4 (64 bins each) to keep the table at 3MB: the bounds of a box are rounded
+   to the bins containing them.
+*/
+
+#ifndef HSVHIST_H
+#define HSVHIST_H
+
+#include <stdint.h>
+#include <vector>
+#include <opencv/highgui.h>
+#include <opencv/cv.h>
+#include "myLib.h"
+
+#define HIST_H_BINS   (MAX_HUE + 1)
+#define HIST_SV_SHIFT 2
+#define HIST_SV_BINS  (256 >> HIST_SV_SHIFT)
+
+class HSVHistogram
+{
+   public:
+      HSVHistogram(void);
+
+      void clear();
+      // accumulates an HSV frame (CV_8UC3, as produced by cvtColor(..., CV_BGR2HSV)) and updates the table
+      void add(const cv::Mat &hsv);
+
+      uint64_t total() const { return pixels; }
+      // pixels such that min <= pixel <= max
+      uint64_t count(const HSV &min, const HSV &max) const;
+      double coverage(const HSV &min, const HSV &max) const;
+
+      // shrinks the box one bin at a time, each time dropping the face that loses the fewest pixels,
+      // as long as at least 'keep' (0..1) of the pixels initially inside the box are still inside. A box
+      // with no pixel (nothing seen yet, or hue bounds wrapping around 0) is left as it is
+      void tighten(HSV &min, HSV &max, double keep) const;
+
+   private:
+      uint64_t sum(int h0, int h1, int s0, int s1, int v0, int v1) const;   // bin ranges, inclusive
+      uint32_t &at(int h, int s, int v) { return table[((size_t)h*(HIST_SV_BINS + 1) + s)*(HIST_SV_BINS + 1) + v]; }
+      uint32_t at(int h, int s, int v) const { return table[((size_t)h*(HIST_SV_BINS + 1) + s)*(HIST_SV_BINS + 1) + v]; }
+
+      std::vector<uint32_t> hist;    // HIST_H_BINS x HIST_SV_BINS x HIST_SV_BINS
+      std::vector<uint32_t> table;   // prefix sums, with a leading plane of zeros on every axis
+      uint64_t pixels;
+};
+
+#endif
@@ -0,0 +1,130 @@
+/*
+   Instantiations and dispatch of the specialised kernels. See kernels.h.
+*/
+
+#include <stdio.h>
+#include <algorithm>
+#include "kernels.h"
+#if KERNEL_HSV_DISPATCH && defined(__arm__)
+#include <sys/auxv.h>
+#ifndef HWCAP_NEON
+#define HWCAP_NEON (1 << 12)   // asm/hwcap.h
+#endif
+#endif
+
+using namespace std;
+using namespace cv;
+
+// [layout][colours - 1]
+#define HSV_KERNELS(L)  { ClassifyHSV<1, L>, ClassifyHSV<2, L>, ClassifyHSV<3, L>, ClassifyHSV<4, L>, \
+                          ClassifyHSV<5, L>, ClassifyHSV<6, L>, ClassifyHSV<7, L>, ClassifyHSV<8, L> }
+
+static const HSVKernel hsvKernels[2][KERNEL_MAX_COLOURS] =
+{
+   HSV_KERNELS(MASK_SEPARATE),
+   HSV_KERNELS(MASK_PACKED)
+};
+
+// [format][layout][colours - 1]
+#define YUV_KERNELS(F, L)  { ClassifyYUV<1, F, L>, ClassifyYUV<2, F, L>, ClassifyYUV<3, F, L>, ClassifyYUV<4, F, L>, \
+                             ClassifyYUV<5, F, L>, ClassifyYUV<6, F, L>, ClassifyYUV<7, F, L>, ClassifyYUV<8, F, L> }
+
+static const YUVKernel yuvKernels[2][2][KERNEL_MAX_COLOURS] =
+{
+   { YUV_KERNELS(YUV_FORMAT_YUYV, MASK_SEPARATE), YUV_KERNELS(YUV_FORMAT_YUYV, MASK_PACKED) },
+   { YUV_KERNELS(YUV_FORMAT_NV12, MASK_SEPARATE), YUV_KERNELS(YUV_FORMAT_NV12, MASK_PACKED) }
+};
+
+//*********************************************************************************************************************
+HSVKernel SelectHSVKernel(int HowManyColours, MaskLayout layout)
+{
+   if (HowManyColours < 1 || HowManyColours > KERNEL_MAX_COLOURS || HSVKernelTarget() == NULL)
+      return NULL;
+   return hsvKernels[layout][HowManyColours - 1];
+}
+
+std::string DescribeHSVKernel(int HowManyColours)
+{
+   char text[96];
+
+   if (SelectHSVKernel(HowManyColours, MASK_SEPARATE) != NULL)
+      snprintf(text, sizeof(text), "HSV kernel specialised on %d colours (%s)", HowManyColours, HSVKernelTarget());
+   else if (HSVKernelTarget() == NULL)
+      snprintf(text, sizeof(text), "one inRange() per colour (no SSSE3/NEON on this CPU)");
+   else
+      snprintf(text, sizeof(text), "one inRange() per colour (more than %d colours)", KERNEL_MAX_COLOURS);
+   return text;
+}
+
+const char* HSVKernelTarget()
+{
+#if KERNEL_HSV_VECTORISED && defined(__SSSE3__)
+   return "SSSE3";
+#elif KERNEL_HSV_VECTORISED
+   return "NEON";
+#elif KERNEL_HSV_DISPATCH && defined(__arm__)
+   static const bool neon = (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+
+   return neon ? "NEON" : NULL;
+#elif KERNEL_HSV_DISPATCH
+   static const bool ssse3 = __builtin_cpu_supports("ssse3");
+
+   return ssse3 ? "SSSE3" : NULL;
+#else
+   return NULL;
+#endif
+}
+
+YUVKernel SelectYUVKernel(int HowManyColours, YUVFormat format, MaskLayout layout)
+{
+   if (HowManyColours < 1 || HowManyColours > KERNEL_MAX_COLOURS)
+      return NULL;
+   return yuvKernels[format][layout][HowManyColours - 1];
+}
+//*********************************************************************************************************************
+
+//*********************************************************************************************************************
+bool SetKernelBounds(KernelBounds &bounds, HSV** FiltersParams, int HowManyColours)
+{
+   if (HowManyColours > KERNEL_MAX_COLOURS)
+      return false;
+
+   for (int i = 0; i < HowManyColours; i++)
+   {
+      const int lo[3] = { FiltersParams[0][i].hue, FiltersParams[0][i].sat, FiltersParams[0][i].val };
+      const int hi[3] = { FiltersParams[1][i].hue, FiltersParams[1][i].sat, FiltersParams[1][i].val };
+      bool empty = false;
+
+      for (int k = 0; k < 3; k++)
+      {
+         bounds.min[i][k] = (uchar)min(max(lo[k], 0), 255);
+         bounds.max[i][k] = (uchar)min(max(hi[k], 0), 255);
+         empty = empty || lo[k] > hi[k] || lo[k] > 255 || hi[k] < 0;
+      }
+
+      // nothing passes inRange() on 8 bit images: 255 <= x <= 0 keeps it that way
+      if (empty)
+         for (int k = 0; k < 3; k++)
+         {
+            bounds.min[i][k] = 255;
+            bounds.max[i][k] = 0;
+         }
+   }
+
+   return true;
+}
+
+void UnpackMask(const Mat &packed, int colour, Mat &mask)
+{
+   mask.create(packed.size(), CV_8UC1);
+
+   for (int r = 0; r < packed.rows; r++)
+   {
+      const uchar* p = packed.ptr<uchar>(r);
+      uchar* out = mask.ptr<uchar>(r);
+
+      for (int x = 0; x < packed.cols; x++)
+         out[x] = (uchar)(0 - ((p[x] >> colour) & 1));
+   }
+}
+//*********************************************************************************************************************
@@ -0,0 +1,227 @@
+/*
+   Per-pixel classification kernels specialised at compile time.
+
+   The generic paths loop over a runtime number of colours for every pixel (one inRange() pass per
+   colour with cv::Scalar bounds, or a loop on the bits of the YUV lookup table). The kernels below are
+   templates on the number of colours (1 to KERNEL_MAX_COLOURS), on the input format (HSV image, raw
+   YUYV or NV12 through the YUVClassifier table) and on the mask layout, so that the tests of all the
+   colours are unrolled and done in a single pass over the frame:
+
+      MASK_SEPARATE   one 0/255 mask per colour, ready for analyzeMask()
+      MASK_PACKED     one mask with bit i set for colour i: one byte written per pixel instead of N,
+                      each colour is extracted with UnpackMask() right before its analysis
+
+   Every combination is instantiated in kernels.cpp and the Select...() functions pick one from a
+   table given the number of colours of the deployment, so a fixed colour set gets the specialised
+   code without rebuilding. They return NULL when there is no instantiation (e.g. more than
+   KERNEL_MAX_COLOURS colours): the caller then takes the generic path.
+
+   The results are exactly those of the generic paths: same bounds (inclusive), same lookup table.
+
+   The HSV kernels rely on the compiler to vectorise them, which needs loads that de-interleave the 3
+   channels (NEON, SSSE3 and later). On CPUs without them one inRange() per colour is faster, so they
+   are not selected. The default flags don't enable them (plain x86-64, 32 bit Raspberry Pi OS): the
+   HSV kernels are then built for SSSE3 / NEON alone (KERNEL_HSV_DISPATCH) and used only if the CPU
+   running the program has it, see HSVKernelTarget(). No special flag is needed.
+*/
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stdint.h>
+#include <string>
+#include <opencv/highgui.h>
+#include <opencv/cv.h>
+#include "myLib.h"
+#include "yuv.h"
+
+#define KERNEL_MAX_COLOURS 8   // also the number of bits of a packed mask
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__SSSE3__)
+#define KERNEL_HSV_VECTORISED 1   // the whole program is built for them
+#else
+#define KERNEL_HSV_VECTORISED 0
+#endif
+
+// otherwise the HSV kernels alone are built for them, the CPU is checked at run time
+#if !KERNEL_HSV_VECTORISED && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KERNEL_HSV_DISPATCH   1
+#define KERNEL_HSV_ATTRIBUTE  __attribute__((target("ssse3")))
+#elif !KERNEL_HSV_VECTORISED && defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 9 && defined(__arm__) && \
+      defined(__linux__)
+#define KERNEL_HSV_DISPATCH   1
+#define KERNEL_HSV_ATTRIBUTE  __attribute__((target("arch=armv7-a,fpu=neon")))
+#else
+#define KERNEL_HSV_DISPATCH   0
+#define KERNEL_HSV_ATTRIBUTE
+#endif
+
+// the helpers must end up inside the kernels to be built for the same instructions
+#define KERNEL_INLINE inline __attribute__((always_inline))
+
+enum MaskLayout
+{
+   MASK_SEPARATE,
+   MASK_PACKED
+};
+
+// HSV boxes of the colours as the kernels read them: bytes, so that the tests can be vectorised
+struct KernelBounds
+{
+   uchar min[KERNEL_MAX_COLOURS][3], max[KERNEL_MAX_COLOURS][3];
+};
+
+// masks[] must hold HowManyColours Mats (MASK_SEPARATE) or one (MASK_PACKED), they are (re)allocated as needed
+typedef void (*HSVKernel)(const cv::Mat &hsv, const KernelBounds &bounds, cv::Mat masks[]);
+typedef void (*YUVKernel)(const cv::Mat &raw, cv::Size size, const YUVClassifier &classifier, cv::Mat masks[]);
+
+HSVKernel SelectHSVKernel(int HowManyColours, MaskLayout layout);
+// instructions the HSV kernels use on this CPU ("SSSE3", "NEON"), NULL if it has none of them: then
+// SelectHSVKernel() always returns NULL
+const char* HSVKernelTarget();
+// what DetectObjects() runs by default for HowManyColours colours, to be printed when sensing starts
+std::string DescribeHSVKernel(int HowManyColours);
+YUVKernel SelectYUVKernel(int HowManyColours, YUVFormat format, MaskLayout layout);
+
+// returns false if there are too many colours for the kernels
+bool SetKernelBounds(KernelBounds &bounds, HSV** FiltersParams, int HowManyColours);
+// mask = 255 where bit 'colour' of 'packed' is set, 0 elsewhere
+void UnpackMask(const cv::Mat &packed, int colour, cv::Mat &mask);
+
+
+// GCC vectorises only at -O3 (before version 12 not even the cheap loops at -O2): ask for it here
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC optimize ("tree-vectorize")
+#endif
+
+//*********************************************************************************************************************
+// Unrolling helpers: Colours<I, N> handles colour I and recurses on I + 1, Colours<N, N> stops
+
+template<int I, int N, MaskLayout L>
+struct Colours
+{
+   // one row of HSV pixels against box I. The row stays in the L1 cache from one colour to the next, and
+   // every loop is simple enough to be vectorised
+   static KERNEL_INLINE void test(const uchar* __restrict p, int cols, const KernelBounds &b, uchar* out[])
+   {
+      uchar* __restrict o = out[L == MASK_SEPARATE ? I : 0];
+      const uchar h0 = b.min[I][0], h1 = b.max[I][0], s0 = b.min[I][1], s1 = b.max[I][1], v0 = b.min[I][2], v1 = b.max[I][2];
+
+      for (int x = 0; x < cols; x++)
+      {
+         uchar h = p[3*x], s = p[3*x + 1], v = p[3*x + 2];
+         uchar in = (h >= h0) & (h <= h1) & (s >= s0) & (s <= s1) & (v >= v0) & (v <= v1);
+
+         if (L == MASK_SEPARATE)
+            o[x] = (uchar)(0 - in);
+         else if (I == 0)
+            o[x] = in;
+         else
+            o[x] |= in << I;
+      }
+      Colours<I + 1, N, L>::test(p, cols, b, out);
+   }
+
+   // bits of the YUV lookup table of two neighbouring pixels
+   static inline void store(uint16_t b0, uint16_t b1, uchar* out[], int x)
+   {
+      if (L == MASK_SEPARATE)
+      {
+         out[I][x]     = (uchar)(0 - ((b0 >> I) & 1));
+         out[I][x + 1] = (uchar)(0 - ((b1 >> I) & 1));
+      }
+      Colours<I + 1, N, L>::store(b0, b1, out, x);
+   }
+};
+
+template<int N, MaskLayout L>
+struct Colours<N, N, L>
+{
+   static KERNEL_INLINE void test(const uchar* __restrict, int, const KernelBounds &, uchar* []) {}
+   static inline void store(uint16_t, uint16_t, uchar* [], int) {}
+};
+
+static KERNEL_INLINE void KernelCreateMasks(cv::Size size, int count, cv::Mat masks[])
+{
+   for (int i = 0; i < count; i++)
+      masks[i].create(size, CV_8UC1);
+}
+//*********************************************************************************************************************
+
+//*********************************************************************************************************************
+template<int N, MaskLayout L>
+KERNEL_HSV_ATTRIBUTE void ClassifyHSV(const cv::Mat &hsv, const KernelBounds &bounds, cv::Mat masks[])
+{
+   const int outputs = L == MASK_SEPARATE ? N : 1;
+   uchar* out[outputs];
+
+   KernelCreateMasks(hsv.size(), outputs, masks);
+
+   for (int r = 0; r < hsv.rows; r++)
+   {
+      for (int i = 0; i < outputs; i++)
+         out[i] = masks[i].ptr<uchar>(r);
+
+      Colours<0, N, L>::test(hsv.ptr<uchar>(r), hsv.cols, bounds, out);
+   }
+}
+
+template<int N, YUVFormat F, MaskLayout L>
+void ClassifyYUV(const cv::Mat &raw, cv::Size size, const YUVClassifier &classifier, cv::Mat masks[])
+{
+   const int outputs = L == MASK_SEPARATE ? N : 1;
+   uchar* out[outputs];
+
+   KernelCreateMasks(size, outputs, masks);
+
+   for (int r = 0; r < size.height; r++)
+   {
+      for (int i = 0; i < outputs; i++)
+         out[i] = masks[i].ptr<uchar>(r);
+
+      // two pixels at a time: they share the same chroma in both formats
+      if (F == YUV_FORMAT_YUYV)
+      {
+         const uchar* p = raw.ptr<uchar>(r);   // Y0 U Y1 V
+
+         for (int x = 0; x < size.width; x += 2, p += 4)
+         {
+            uint16_t b0 = classifier.lookup(p[0], p[1], p[3]), b1 = classifier.lookup(p[2], p[1], p[3]);
+
+            if (L == MASK_PACKED)
+            {
+               out[0][x] = (uchar)b0;
+               out[0][x + 1] = (uchar)b1;
+            }
+            else
+               Colours<0, N, L>::store(b0, b1, out, x);
+         }
+      }
+      else
+      {
+         const uchar* py  = raw.ptr<uchar>(r);                   // Y plane
+         const uchar* puv = raw.ptr<uchar>(size.height + r/2);   // interleaved UV, one row every two
+
+         for (int x = 0; x < size.width; x += 2)
+         {
+            uint16_t b0 = classifier.lookup(py[x], puv[x], puv[x + 1]), b1 = classifier.lookup(py[x + 1], puv[x], puv[x + 1]);
+
+            if (L == MASK_PACKED)
+            {
+               out[0][x] = (uchar)b0;
+               out[0][x + 1] = (uchar)b1;
+            }
+            else
+               Colours<0, N, L>::store(b0, b1, out, x);
+         }
+      }
+   }
+}
+//*********************************************************************************************************************
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+#endif
@@ -0,0 +1,391 @@
+/*
+   Live reconfiguration of the detection. See liveconfig.h.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <iostream>
+#include <chrono>
+#include "liveconfig.h"
+
+using namespace std;
+using namespace cv;
+
+//*********************************************************************************************************************
+ConfigSnapshot::ConfigSnapshot(HSV** FiltersParams, int HowManyColours, const DetectParams &params, bool yuv) :
+   generation(0), HowManyColours(HowManyColours), params(params), yuv(yuv)
+{
+   this->FiltersParams = AllocFilters(HowManyColours);
+   for (int i = 0; i < HowManyColours; i++)
+   {
+      this->FiltersParams[0][i] = FiltersParams[0][i];
+      this->FiltersParams[1][i] = FiltersParams[1][i];
+   }
+
+   if (yuv)
+      classifier.build(this->FiltersParams, HowManyColours);   // left empty with too many colours
+}
+
+ConfigSnapshot::~ConfigSnapshot(void)
+{
+   FreeFilters(FiltersParams);
+}
+//*********************************************************************************************************************
+
+//*********************************************************************************************************************
+LiveConfig::LiveConfig(void) : latest(NULL), lastGeneration(0)
+{
+   for (int r = 0; r < LIVE_MAX_READERS; r++)
+   {
+      seen[r].store(UINT64_MAX);
+      used[r].store(false);
+   }
+}
+
+LiveConfig::~LiveConfig(void)
+{
+   reset();
+}
+
+void LiveConfig::reset()
+{
+   lock_guard<mutex> lock(writer);
+
+   for (size_t k = 0; k < retired.size(); k++)
+      delete retired[k];
+   retired.clear();
+   delete latest.exchange(NULL);
+}
+
+bool LiveConfig::publish(HSV** FiltersParams, int HowManyColours, const DetectParams &params, bool yuv)
+{
+   lock_guard<mutex> lock(writer);
+
+   return replace(FiltersParams, HowManyColours, params, yuv);
+}
+
+bool LiveConfig::publish(HSV** FiltersParams, int HowManyColours, const DetectParams &params)
+{
+   lock_guard<mutex> lock(writer);
+   ConfigSnapshot* current = latest.load();
+
+   return current != NULL && replace(FiltersParams, HowManyColours, params, current->yuv);
+}
+
+bool LiveConfig::publishFilter(int colour, HSV min, HSV max)
+{
+   lock_guard<mutex> lock(writer);
+   ConfigSnapshot* current = latest.load();
+
+   if (current == NULL || colour < 0 || colour >= current->HowManyColours)
+      return false;
+
+   HSV** FiltersParams = AllocFilters(current->HowManyColours);
+   for (int i = 0; i < current->HowManyColours; i++)
+   {
+      FiltersParams[0][i] = current->FiltersParams[0][i];
+      FiltersParams[1][i] = current->FiltersParams[1][i];
+   }
+   FiltersParams[0][colour] = min;
+   FiltersParams[1][colour] = max;
+
+   bool done = replace(FiltersParams, current->HowManyColours, current->params, current->yuv);
+   FreeFilters(FiltersParams);
+
+   return done;
+}
+
+bool LiveConfig::publishParams(const DetectParams &params)
+{
+   lock_guard<mutex> lock(writer);
+   ConfigSnapshot* current = latest.load();
+
+   return current != NULL && replace(current->FiltersParams, current->HowManyColours, params, current->yuv);
+}
+
+uint64_t LiveConfig::generation()
+{
+   lock_guard<mutex> lock(writer);   // the latest snapshot can't be freed meanwhile
+   ConfigSnapshot* current = latest.load();
+
+   return current != NULL ? current->generation : 0;
+}
+
+DetectParams LiveConfig::params()
+{
+   lock_guard<mutex> lock(writer);
+   ConfigSnapshot* current = latest.load();
+
+   return current != NULL ? current->params : DetectParams();
+}
+
+bool LiveConfig::replace(HSV** FiltersParams, int HowManyColours, const DetectParams &params, bool yuv)
+{
+   ConfigSnapshot* current = latest.load();
+
+   if (FiltersParams == NULL || HowManyColours <= 0 || !params.valid())
+      return false;
+   if (current != NULL && current->HowManyColours != HowManyColours)
+      return false;
+
+   // the lookup table is built here, the readers keep working with the current snapshot meanwhile
+   ConfigSnapshot* snapshot = new ConfigSnapshot(FiltersParams, HowManyColours, params, yuv);
+   snapshot->generation = ++lastGeneration;
+
+   snapshot->filterGenerations.resize(HowManyColours);
+   for (int i = 0; i < HowManyColours; i++)
+   {
+      bool same = current != NULL && current->FiltersParams[0][i] == FiltersParams[0][i] &&
+                  current->FiltersParams[1][i] == FiltersParams[1][i];
+
+      snapshot->filterGenerations[i] = same ? current->filterGenerations[i] : snapshot->generation;
+   }
+
+   latest.store(snapshot);
+   if (current != NULL)
+      retired.push_back(current);
+   reclaim();
+
+   return true;
+}
+
+void LiveConfig::reclaim()
+{
+   uint64_t oldest = UINT64_MAX;
+
+   // a reader works with the generation it stored or with a newer one (it stores it right after loading
+   // 'latest'), never with an older one: what is older than all of them can go. A reader that just
+   // attached stores 0, which holds everything until its first acquire()
+   for (int r = 0; r < LIVE_MAX_READERS; r++)
+      oldest = min(oldest, seen[r].load());
+
+   for (size_t k = 0; k < retired.size(); )
+      if (retired[k]->generation < oldest)
+      {
+         delete retired[k];
+         retired[k] = retired.back();
+         retired.pop_back();
+      }
+      else
+         k++;
+}
+//*********************************************************************************************************************
+
+//*********************************************************************************************************************
+int LiveConfig::attach()
+{
+   for (int r = 0; r < LIVE_MAX_READERS; r++)
+   {
+      bool expected = false;
+
+      if (used[r].compare_exchange_strong(expected, true))
+      {
+         seen[r].store(0);   // before the first load of 'latest' (both sequentially consistent)
+         return r;
+      }
+   }
+
+   return -1;
+}
+
+void LiveConfig::detach(int reader)
+{
+   seen[reader].store(UINT64_MAX);
+   used[reader].store(false);
+}
+
+const ConfigSnapshot* LiveConfig::acquire(int reader)
+{
+   // one load and one store per frame, no waiting. The previous snapshot of this reader may be freed as
+   // soon as the store is done
+   ConfigSnapshot* snapshot = latest.load();
+
+   seen[reader].store(snapshot != NULL ? snapshot->generation : 0);
+   return snapshot;
+}
+
+void FollowFilterChanges(const ConfigSnapshot* snapshot, vector<uint64_t> &seen, BackgroundModel &background)
+{
+   if (snapshot == NULL)
+      return;
+
+   // the first snapshot seen is what the model starts learning with
+   for (size_t i = 0; i < seen.size() && i < snapshot->filterGenerations.size(); i++)
+      if (seen[i] != snapshot->filterGenerations[i])
+         background.relearn(i);
+
+   seen = snapshot->filterGenerations;
+}
+//*********************************************************************************************************************
+
+//*********************************************************************************************************************
+ConfigWatcher::ConfigWatcher(void) : config(NULL), controlSocket(-1), verbose(false), stopRequested(false)
+{
+   memset(stamp, 0, sizeof(stamp));
+}
+
+ConfigWatcher::~ConfigWatcher(void)
+{
+   stop();
+}
+
+bool ConfigWatcher::start(LiveConfig &config, const char* path, int port, bool verbose, const char* address)
+{
+   stop();
+
+   this->config  = &config;
+   this->path    = path != NULL ? path : "";
+   this->verbose = verbose;
+
+   if (port > 0)
+   {
+      sockaddr_in local;
+
+      memset(&local, 0, sizeof(local));
+      local.sin_family      = AF_INET;
+      local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);   // no authentication: not on the network unless asked
+      local.sin_port        = htons(port);
+      if (address != NULL && inet_pton(AF_INET, address, &local.sin_addr) != 1)
+         return false;
+
+      controlSocket = socket(AF_INET, SOCK_DGRAM, 0);
+      if (controlSocket < 0 || bind(controlSocket, (sockaddr*)&local, sizeof(local)) < 0)
+      {
+         if (controlSocket >= 0)
+            close(controlSocket);
+         controlSocket = -1;
+         return false;
+      }
+   }
+
+   fileChanged();   // what is there now is what was loaded
+   stopRequested.store(false);
+   worker = thread(&ConfigWatcher::run, this);
+
+   return true;
+}
+
+void ConfigWatcher::stop()
+{
+   stopRequested.store(true);
+   if (worker.joinable())
+      worker.join();
+
+   if (controlSocket >= 0)
+      close(controlSocket);
+   controlSocket = -1;
+}
+//*********************************************************************************************************************
+
+//*********************************************************************************************************************
+void ConfigWatcher::run()
+{
+   char text[LIVE_COMMAND_LENGTH];
+
+   while ( !stopRequested.load() )
+   {
+      if (controlSocket < 0)
+         this_thread::sleep_for( chrono::milliseconds(LIVE_WATCH_PERIOD) );
+      else
+      {
+         pollfd descriptor = { controlSocket, POLLIN, 0 };
+
+         // wakes up for every command, or at least once per period to look at the file
+         if ( poll(&descriptor, 1, LIVE_WATCH_PERIOD) > 0 && (descriptor.revents & POLLIN) )
+         {
+            sockaddr_in sender;
+            socklen_t length = sizeof(sender);
+            ssize_t n = recvfrom(controlSocket, text, sizeof(text) - 1, 0, (sockaddr*)&sender, &length);
+
+            if (n > 0)
+            {
+               text[n] = 0;
+               text[strcspn(text, "\r\n")] = 0;
+               string reply = command(text);
+
+               sendto(controlSocket, reply.c_str(), reply.size(), 0, (sockaddr*)&sender, length);
+               if (verbose)
+                  cout << "Control: " << text << ": " << reply << endl;
+            }
+         }
+      }
+
+      if ( !path.empty() && fileChanged() )
+         reload();
+   }
+}
+
+// the file is compared with the last time it was seen, so a file that can't be loaded is tried once per change
+bool ConfigWatcher::fileChanged()
+{
+   struct stat info;
+
+   if ( path.empty() || stat(path.c_str(), &info) != 0 )
+      return false;
+
+   // editors often save to a new file and rename it: the inode changes even within the same second
+   long long now[3] = { (long long)info.st_mtime, (long long)info.st_size, (long long)info.st_ino };
+   bool changed = memcmp(now, stamp, sizeof(stamp)) != 0;
+
+   memcpy(stamp, now, sizeof(stamp));
+   return changed;
+}
+
+void ConfigWatcher::reload()
+{
+   int HowManyColours = 0;
+   HSV** FiltersParams = LoadFilters(path.c_str(), HowManyColours);
+   DetectParams params = config->params();   // the keys missing in the file are kept
+   bool done = FiltersParams != NULL && LoadDetectParams(path.c_str(), params) &&
+               config->publish(FiltersParams, HowManyColours, params);
+
+   if (verbose && done)
+      cout << "Configuration reloaded from " << path << " (generation " << config->generation() << ")." << endl;
+   else if (verbose)
+      cout << path << " changed but can't be used (unreadable, other number of colours or values out of range)." << endl;
+
+   FreeFilters(FiltersParams);
+}
+
+string ConfigWatcher::command(const char* text)
+{
+   int colour, size;
+   double area;
+   HSV min, max;
+   DetectParams params = config->params();
+   bool done;
+   char reply[64];
+
+   if ( sscanf(text, "filter %d %d %d %d %d %d %d", &colour, &min.hue, &min.sat, &min.val, &max.hue, &max.sat, &max.val) == 7 )
+   {
+      bool inside = min.hue >= 0 && max.hue <= MAX_HUE && min.sat >= 0 && max.sat <= MAX_SAT && min.val >= 0 &&
+                    max.val <= MAX_VAL;
+
+      done = inside && config->publishFilter(colour, min, max);
+   }
+   else if ( sscanf(text, "minarea %lf", &area) == 1 )
+   {
+      params.minArea = area;
+      done = config->publishParams(params);
+   }
+   else if ( sscanf(text, "morph %d", &size) == 1 )
+   {
+      params.morphSize = size;
+      done = config->publishParams(params);
+   }
+   else
+      return "error unknown command";
+
+   if (!done)
+      return "error rejected";
+
+   snprintf(reply, sizeof(reply), "ok %llu", (unsigned long long)config->generation());
+   return reply;
+}
+//*********************************************************************************************************************
@@ -0,0 +1,154 @@
+/*
+   Live reconfiguration of the detection while sensing: filters, minimum area and morphology.
+
+   A configuration is an immutable snapshot: a copy of the filters, the DetectParams and everything
+   derived from them (the YUV lookup table, which takes tens of milliseconds to build). A change never
+   touches the snapshot in use: a new one is built in the thread that asks for the change and published
+   by swapping a single atomic pointer. The processing threads pick the latest snapshot at the start of
+   each frame and keep using it until the end of that frame: there are no locks in their path and a
+   frame never sees half of an update.
+
+      LiveConfig live;
+
+      live.publish(FiltersParams, HowManyColours, DetectParams(), yuv);   // the first one
+      int reader = live.attach();                                         // once per processing thread
+
+      while (...)   // processing loop
+      {
+         const ConfigSnapshot* config = live.acquire(reader);   // the one for this frame
+         ...
+      }
+      live.detach(reader);
+
+   A replaced snapshot is freed once every attached reader has acquired a newer one: each reader stores
+   the generation it works with, the writer frees what no reader can be using anymore (RCU-like, with the
+   frame as the grace period). A reader stuck on a frame only delays the reclamation.
+
+   The number of colours can't change once published (the callers size their data on it), except after
+   reset(). The background model (bgmodel.h) learned for a colour doesn't hold with another filter: each
+   snapshot tells the generation where the filter of each colour last changed, and FollowFilterChanges()
+   makes the model of a reader forget those colours (see BackgroundModel::relearn()). The other colours
+   keep their model.
+
+   ConfigWatcher feeds a LiveConfig from outside the program:
+    - a filters file (as saved by SaveFilters()), loaded again whenever it changes. It can also hold the
+      optional keys 'min_area' and 'morph_size' (see LoadDetectParams())
+    - a UDP port taking one text command per datagram, each answered with "ok <generation>" or
+      "error <reason>":
+         filter <colour> <hue min> <sat min> <val min> <hue max> <sat max> <val max>
+         minarea <pixels>
+         morph <size>
+      e.g. echo "minarea 900" | nc -u -w1 127.0.0.1 5600
+      There is no authentication: the port is bound to the loopback interface unless another address is
+      given explicitly (e.g. the one of the robot on the network of the cell, or 0.0.0.0 for every
+      interface). Open it only on a network where anyone may change the detection.
+*/
+
+#ifndef LIVECONFIG_H
+#define LIVECONFIG_H
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <vector>
+#include <opencv/highgui.h>
+#include <opencv/cv.h>
+#include "myLib.h"
+#include "yuv.h"
+#include "bgmodel.h"
+
+#define LIVE_MAX_READERS     8
+#define LIVE_WATCH_PERIOD    250   // ms between two checks of the watched file
+#define LIVE_COMMAND_LENGTH  256
+
+struct ConfigSnapshot
+{
+   uint64_t generation;        // 1 for the first one published, then 2, 3, ...
+   HSV** FiltersParams;        // own copy
+   int HowManyColours;
+   DetectParams params;
+   bool yuv;                   // the lookup table was asked for
+   YUVClassifier classifier;   // empty without yuv or with more than YUV_MAX_COLOURS colours
+   std::vector<uint64_t> filterGenerations;   // per colour, generation where its filter last changed
+
+   ConfigSnapshot(HSV** FiltersParams, int HowManyColours, const DetectParams &params, bool yuv);
+   ~ConfigSnapshot(void);
+};
+
+class LiveConfig
+{
+   public:
+      LiveConfig(void);
+      ~LiveConfig(void);   // every reader must be detached
+
+      // Writer side, any thread (the writers are serialised). The snapshot is built in the calling thread.
+      // Fail if the number of colours changes or the values are invalid.
+      bool publish(HSV** FiltersParams, int HowManyColours, const DetectParams &params, bool yuv);
+      // same, the rest is taken from the latest snapshot (fail if there is none)
+      bool publish(HSV** FiltersParams, int HowManyColours, const DetectParams &params);
+      bool publishFilter(int colour, HSV min, HSV max);
+      bool publishParams(const DetectParams &params);
+      // frees everything, only with no reader attached
+      void reset();
+
+      // of the latest snapshot: 0 if none / DetectParams() if none
+      uint64_t generation();
+      DetectParams params();
+
+      // Reader side. attach() returns -1 if there are already LIVE_MAX_READERS readers. acquire() returns
+      // the latest snapshot (NULL if none was published), valid until the next acquire() or detach() of
+      // the same reader
+      int attach();
+      void detach(int reader);
+      const ConfigSnapshot* acquire(int reader);
+
+   private:
+      // with 'writer' locked
+      bool replace(HSV** FiltersParams, int HowManyColours, const DetectParams &params, bool yuv);
+      void reclaim();
+
+      std::atomic<ConfigSnapshot*> latest;
+      std::atomic<uint64_t> seen[LIVE_MAX_READERS];   // generation in use by each reader, UINT64_MAX if free
+      std::atomic<bool> used[LIVE_MAX_READERS];
+
+      std::mutex writer;
+      std::vector<ConfigSnapshot*> retired;   // replaced, freed as soon as no reader can hold them
+      uint64_t lastGeneration;
+};
+
+// call after each acquire(): 'background' forgets the colours whose filter changed since the previous
+// snapshot of the reader. 'seen' holds the filterGenerations of that snapshot (empty at first) and is
+// updated
+void FollowFilterChanges(const ConfigSnapshot* snapshot, std::vector<uint64_t> &seen, BackgroundModel &background);
+
+class ConfigWatcher
+{
+   public:
+      ConfigWatcher(void);
+      ~ConfigWatcher(void);
+
+      // watches 'path' (NULL for none) and listens on UDP 'port' (0 for none) of the IPv4 'address' (NULL
+      // for the loopback only) in a thread of its own. With 'verbose' the changes and the rejected updates
+      // are printed
+      bool start(LiveConfig &config, const char* path, int port, bool verbose, const char* address = NULL);
+      void stop();
+
+   private:
+      void run();
+      bool fileChanged();
+      void reload();
+      std::string command(const char* text);
+
+      LiveConfig* config;
+      std::string path;
+      int controlSocket;
+      bool verbose;
+      long long stamp[3];   // modification time, size and inode of the file when last seen
+
+      std::thread worker;
+      std::atomic<bool> stopRequested;
+};
+
+#endif
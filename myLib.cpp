@@ -10,28 +10,56 @@
    Might also work on other Operating systems (I'm not sure).
 */
 
+#include <stdio.h>
 #include <string>
 #include <iostream>
 #include <opencv/highgui.h>
 #include <opencv/cv.h>
 #include "myLib.h"
 #include "object.h"
+#include "record.h"
+#include "yuv.h"
+#include "trace.h"
+#include "hsvhist.h"
+#include "calib.h"
+#include "kernels.h"
+#include "bgmodel.h"
+#include "liveconfig.h"
 
 using namespace std;
 using namespace cv;
 
 #define TEST true
 
+// Allocate a 2xN HSV Matrix: FiltersParams[0][i] is the i-th minimum, FiltersParams[1][i] the i-th maximum
+HSV** AllocFilters(int N)
+{
+   HSV** FiltersParams = (HSV **)malloc(2*sizeof(HSV*));   // 2 rows allocation
+   for (int i = 0; i < 2; i++)                             // N columns allocation
+      FiltersParams[i] = (HSV *)malloc(N*sizeof(HSV));
+
+   return FiltersParams;
+}
+
+void FreeFilters(HSV** FiltersParams)
+{
+   if (FiltersParams == NULL)
+      return;
+
+   free(FiltersParams[0]);
+   free(FiltersParams[1]);
+   free(FiltersParams);
+}
+
 HSV** InitialSetup(int N)
 {
    cv::VideoCapture capture;
    cv::Mat camera, cameraHSV, FilteredImage;
    HSV min[N], max[N];   // create a vector of paramters for the filters.
+   HSVHistogram histogram;   // all the snapshots taken during the setup
 
    // Allocate a 2xN HSV Matrix
-   HSV** bars = (HSV **)malloc(2*sizeof(HSV*));   // 2 rows allocation
-   for (int i = 0; i < N; i++)                    // N columns allocation
-      bars[i] = (HSV *)malloc(N*sizeof(HSV));
+   HSV** bars = AllocFilters(N);
 
    for(int n = 0; n < N; n++)   // Fill the parameters with initial condition (0, 0, 0) - (179, 255, 255)
    {   
@@ -49,25 +77,61 @@ HSV** InitialSetup(int N)
    capture.set(CV_CAP_PROP_FRAME_WIDTH,   FRAME_WIDTH);
    capture.set(CV_CAP_PROP_FRAME_HEIGHT, FRAME_HEIGHT);
 
+   // The filters are tuned on snapshots of the scene, not on the live feed: the masks are computed again only
+   // when a bound changes, and the histogram of the snapshots gives the coverage of any box in O(1)
+   capture.read(camera);
+   cvtColor(camera, cameraHSV, CV_BGR2HSV);
+   histogram.add(cameraHSV);
 
    for (int i = 0; i < N; i++)
    {
+      HSV shownMin = min[i], shownMax = max[i];
+      bool refresh = true;
+      char key = 0;
+
       // Create trackbars for the HSV filtering
       createTrackbarsForHSVSel( &(min[i]), &(max[i]) );
 
-      cout << "Press n to skip to the next filter.\n";
+      cout << "Press n to skip to the next filter, c to add a snapshot, r to start again from a new snapshot,\n";
+      cout << "a to shrink the box to the " << 100*SETUP_TIGHTEN_KEEP << "% of its pixels.\n";
+
+      while ( (key = (char)cv::waitKey(30)) != 'n' )   // execute the filtering untill the user presses 'n'
+      {
+         if (key == 'c' || key == 'r')
+         {
+            if (key == 'r')
+               histogram.clear();
+            capture.read(camera);   // store the image on camera
+            cvtColor(camera, cameraHSV, CV_BGR2HSV);   // cameraHSV = HSV_trasformation(camera)
+            histogram.add(cameraHSV);
+            refresh = true;
+         }
+         else if (key == 'a')
+         {
+            histogram.tighten(min[i], max[i], SETUP_TIGHTEN_KEEP);
+            setTrackbarsForHSVSel(min[i], max[i]);
+         }
+
+         if ( !refresh && min[i] == shownMin && max[i] == shownMax )
+            continue;   // nothing changed: nothing to compute
 
-      while ( (char)cv::waitKey(30) != 'n' )   // execute the filtering untill the user presses 'n'
-      {   
-         capture.read(camera);   // store the image on camera
-         cvtColor(camera, cameraHSV, CV_BGR2HSV);   // cameraHSV = HSV_trasformation(camera)
          // Create binary of pixels such that: minHSV < pixel < maxHSV. Save it in "FilteredImage"
          inRange(cameraHSV, Scalar(min[i].hue, min[i].sat, min[i].val), Scalar(max[i].hue, max[i].sat, max[i].val), FilteredImage);
          morphOps(FilteredImage);   // morphological operations: they allow to close the 'holes' and delete the 'dots'
 
+         // coverage of the box on all the snapshots taken so far
+         char text[64];
+         snprintf(text, sizeof(text), "%.2f%% of %d snapshot pixels", 100*histogram.coverage(min[i], max[i]),
+                  (int)histogram.total());
+         putText(FilteredImage, text, Point(10, 20), CV_FONT_HERSHEY_SIMPLEX, 0.5, Scalar(128), 1, 8);
+
          // Show the results
          imshow("Original", camera);
          imshow("Filtered", FilteredImage);
+
+         shownMin = min[i];
+         shownMax = max[i];
+         refresh  = false;
       }
 
       bars[0][i] = min[i]; bars[1][i] = max[i];
@@ -148,33 +212,64 @@ void DebugMode()
 }
 
 //*********************************************************************************************************************
-void SensingMode(int HowManyColours)
+void SensingMode(int HowManyColours, const SensingOptions &options)
 {
-   cv::Mat src, srcHSV, filter[HowManyColours];   // source image and filtered ones
-   Mat edges[HowManyColours];
+   cv::Mat src;                                   // source image
 
    vector<Object> targets[HowManyColours];        // all the objects found are stored here
                                                   // and divided by colour
-   
-   vector<vector<Point> > contours[HowManyColours];
-   vector<Vec4i> hierarchy[HowManyColours];
 
    // vector <Mat > filter;  <== this might be better
    VideoCapture capture;                  // VideoCapture object to get frames from camera
    
+   Recorder recorder;                     // optional recording of the session (see record.h)
+   uint64_t frameId = 0;
+   int64_t timestamp;
+
    char input;
    bool CORRECT_SETUP = false;
 
    // Filter[i] will be the i-th filtered (binary) image. All the objects of such colour will
    // be visible here.
    
-   // Allocate a 2xN HSV Matrix
-   HSV** FiltersParams = (HSV **)malloc(2*sizeof(HSV*));       // 2 rows allocation
-   for (int i = 0; i < HowManyColours; i++)                    // N columns allocation
-      FiltersParams[i] = (HSV *)malloc(HowManyColours*sizeof(HSV));
+   HSV** FiltersParams = NULL;
+
+   LiveConfig live;                       // filters and parameters, they can change while sensing
+   ConfigWatcher watcher;                 // used only with options.live or options.controlPort
+   const ConfigSnapshot* config;          // the ones for the current frame
+   DetectParams params;
+   int reader;
+   vector<Mat> masks;
+   YUVFormat format;
+   Size frameSize;                        // as accepted by the camera: raw YUV frames are laid out on it
+   bool yuvFrame, warned = false;
+   RecPixels pixels;                      // what src holds, for the recording
+   Mat raw;
+
+   CameraCalibration calibration;         // used only with options.worldPath
+
+   DetectWorkspace workspace;             // images kept from one frame to the next
+   BackgroundModel background;            // used only with options.background
+   vector<uint64_t> filterGenerations;    // of the last snapshot, to relearn the colours changed since
+   uint64_t objectCount = 0;
+
+   if ( options.filtersPath != NULL )
+   {
+      int savedColours = 0;
 
-   do
+      FiltersParams = LoadFilters(options.filtersPath, savedColours);
+      if ( FiltersParams != NULL && savedColours != HowManyColours )
+      {
+         cout << options.filtersPath << " holds " << savedColours << " filters, not " << HowManyColours << "." << endl;
+         FreeFilters(FiltersParams);
+         FiltersParams = NULL;
+      }
+      CORRECT_SETUP = FiltersParams != NULL;
+   }
+
+   while( !CORRECT_SETUP )
    {
+      FreeFilters(FiltersParams);                     // previous (rejected) setup, if any
       FiltersParams = InitialSetup(HowManyColours);   // FilterParams[0][i] contains the i-th minimum
                                                       // FilterParams[1][i] contains the i-th maximum
       do
@@ -193,7 +288,9 @@ void SensingMode(int HowManyColours)
             CORRECT_SETUP = false;
       } while ( input != 'y' && input != 'Y' && input != 'n' && input != 'N' );
 
-   } while( !CORRECT_SETUP );
+      if ( CORRECT_SETUP && options.filtersPath != NULL && SaveFilters(options.filtersPath, FiltersParams, HowManyColours) )
+         cout << "Filters saved in " << options.filtersPath << endl;
+   }
 
    // Camera feed setup
    capture.open(0);
@@ -203,38 +300,137 @@ void SensingMode(int HowManyColours)
       cout << "Not able to detect a camera or the object is not working correctly." << endl;
       cout << "Exiting." << endl;
 
+      FreeFilters(FiltersParams);
       return;
    }
 
+   if ( options.yuv )
+   {
+      // Ask for the raw frames. If the backend ignores us the frames are BGR and the usual path is taken
+      capture.set(CV_CAP_PROP_FRAME_WIDTH,  FRAME_WIDTH);
+      capture.set(CV_CAP_PROP_FRAME_HEIGHT, FRAME_HEIGHT);
+      capture.set(CV_CAP_PROP_FOURCC, CV_FOURCC('Y','U','Y','V'));
+      capture.set(CV_CAP_PROP_CONVERT_RGB, 0);
+   }
+   frameSize = Size((int)capture.get(CV_CAP_PROP_FRAME_WIDTH), (int)capture.get(CV_CAP_PROP_FRAME_HEIGHT));
+
+   // from here on the filters and the parameters are read from the snapshots only (see liveconfig.h)
+   if ( options.filtersPath != NULL )
+      LoadDetectParams(options.filtersPath, params);
+   live.publish(FiltersParams, HowManyColours, params, options.yuv);
+   reader = live.attach();
+   config = live.acquire(reader);
+
+   if ( options.yuv && config->classifier.empty() )
+      cout << "The YUV path supports up to " << YUV_MAX_COLOURS << " colours, using the HSV one." << endl;
+   cout << "Classification of the BGR frames: " << DescribeHSVKernel(HowManyColours) << "." << endl;
+
+   if ( (options.live || options.controlPort > 0) &&
+        !watcher.start(live, options.live ? options.filtersPath : NULL, options.controlPort, true, options.controlAddress) )
+      cout << "Not able to listen on UDP port " << options.controlPort << " of "
+           << (options.controlAddress != NULL ? options.controlAddress : "127.0.0.1") << ". Going on without it." << endl;
+
+   if ( options.worldPath != NULL )
+   {
+      if ( !calibration.load(options.worldPath) )
+         cout << "Not able to load the calibration from " << options.worldPath << ". Going on in pixels." << endl;
+      else if ( calibration.imageSize() != frameSize )
+         cout << "Warning: " << options.worldPath << " was made for " << calibration.imageSize().width << "x"
+              << calibration.imageSize().height << " frames." << endl;
+   }
+
+   // encoded and written by a thread of its own: the recording must not change the timing of the session
+   if ( options.recordPath != NULL && !recorder.open(options.recordPath, REC_ENCODING_PNG, true) )
+      cout << "Not able to open " << options.recordPath << " for recording. Going on without it." << endl;
+
+   if ( options.background )
+   {
+      workspace.background = &background;
+      cout << "Learning the background on the first " << BG_LEARN_FRAMES << " frames: keep the objects out of the scene." << endl;
+   }
+
+   TraceSetThreadName("sensing");
+
    while( (char)waitKey(30) != 'q' )
    {
-      capture.read(src);   // get the frame from camera
+      TraceSetFrame(frameId);
+      config = live.acquire(reader);   // a change made meanwhile is taken here, never in the middle of a frame
+      workspace.params = config->params;
+      FollowFilterChanges(config, filterGenerations, background);
 
-      // Detect everything we can in the i-th filtered image
-      for( int i = 0; i < HowManyColours; i++ )
       {
-         // filtering -> blurring -> Canny edge detection -> Objects analysis
-         cvtColor(src, srcHSV, CV_BGR2HSV);     // convert such frame in the HSV colour space
-         inRange(srcHSV, Scalar( FiltersParams[0][i].hue, FiltersParams[0][i].sat, FiltersParams[0][i].val ),
-            Scalar( FiltersParams[1][i].hue, FiltersParams[1][i].sat, FiltersParams[1][i].val ), filter[i] );
-         morphOps( filter[i] );
-         // filter[i] now contains the binary that only displays the i-th colour.
+         TRACE_SPAN("capture");
+         capture.read(raw);   // get the frame from camera
+         timestamp = NowMicroseconds();
+      }
+
+      // Detect everything we can in the i-th filtered image. Only BGR frames can take the HSV path
+      yuvFrame = options.yuv && GuessYUVLayout(raw, frameSize, format, src);
+      pixels = REC_PIXELS_BGR;
+      if ( yuvFrame && !config->classifier.empty() )
+      {
+         DetectObjectsYUV(src, format, frameSize, config->classifier, masks, targets, workspace.background,
+                          config->params);
+         pixels = format == YUV_FORMAT_YUYV ? REC_PIXELS_YUYV : REC_PIXELS_NV12;
+      }
+      else if ( yuvFrame )   // too many colours for the lookup table
+      {
+         YUVToBGR(src, format, src);
+         DetectObjects(src, config->FiltersParams, HowManyColours, targets, workspace);
+      }
+      else if ( raw.type() == CV_8UC3 )
+      {
+         src = raw;
+         DetectObjects(src, config->FiltersParams, HowManyColours, targets, workspace);
+      }
+      else
+      {
+         if ( !warned )
+            cout << "Skipping the frames of " << raw.cols << "x" << raw.rows << " type " << raw.type()
+                 << ": neither BGR nor the expected " << frameSize.width << "x" << frameSize.height << " YUV." << endl;
+         warned = true;
+         continue;
+      }
 
-         // Apply Gaussian blurring and Canny edge algorithm for the edge detection
-         GaussianBlur(filter[i], filter[i], Size(3,3), 0, 0);   // Kernel = 3x3, Sigmas are calculated automatically
-                                                                // (see 'getGaussianKernel()')
-         Canny(filter[i], edges[i], 0, 100);
+      for (int i = 0; i < HowManyColours; i++)
+         objectCount += targets[i].size();
 
-         targets[i] = analyzeContours(filter[i]);
+      if ( !calibration.empty() )   // only the points of the objects are mapped, never the frame
+      {
+         TRACE_SPAN("toWorld");
+         calibration.mapObjects(targets, HowManyColours);
       }
 
+      if ( recorder.isOpen() )   // must be done before drawing on src
+      {
+         TRACE_SPAN("record");
+         recorder.write(frameId, timestamp, src, config->FiltersParams, HowManyColours, targets, config->params,
+                        pixels);
+      }
+      frameId++;
+
+      // up to the end of the iteration: drawing and imshow(). waitKey() runs in the loop condition, outside
+      // of any span: its 30 ms show as a gap between the frames of the trace
+      TRACE_SPAN("display");
+
       //===============================================================================================================
       // used for testing
       #if TEST == true
+      if ( src.type() != CV_8UC3 )   // raw YUV: converted only to be shown
+         YUVToBGR(src, format, src);
+
       for(int i = 0; i < HowManyColours; i++)
          for(int j = 0; j < targets[i].size(); j++)
          {
             DrawObecjtCenter(src, targets[i].at(j));
+
+            if ( targets[i].at(j).isMapped() )
+            {
+               char text[64];
+               snprintf(text, sizeof(text), "%.1f, %.1f mm", targets[i].at(j).getWorldCenter().x, targets[i].at(j).getWorldCenter().y);
+               putText(src, text, Point(targets[i].at(j).getXCenter() + 12, targets[i].at(j).getYCenter()),
+                       CV_FONT_HERSHEY_SIMPLEX, 0.4, Scalar(255,255,255), 1, 8);
+            }
          }
 
       /* The "DrawObjectCenter" solution is better in terms of readability
@@ -263,13 +459,200 @@ void SensingMode(int HowManyColours)
       //===============================================================================================================
    }
 
+   if ( options.background && frameId > 0 )
+   {
+      cout << (double)objectCount/frameId << " objects per frame. Static background ignored:";
+      for (int i = 0; i < background.colours(); i++)
+         cout << " " << 100*background.staticFraction(i) << "%";
+      cout << " of the frame (one value per colour)" << endl;
+   }
+
+   watcher.stop();
+   live.detach(reader);
+   recorder.close();
+   if (recorder.droppedFrames() > 0)
+      cout << recorder.droppedFrames() << " recorded frames were dropped: the writer could not keep up" << endl;
    destroyAllWindows();
    capture.release();
+   FreeFilters(FiltersParams);
+
+   return;
+}
+//*********************************************************************************************************************
+
+//*********************************************************************************************************************
+// runs the whole detection pipeline on a BGR frame. targets[i] receives the objects of the i-th colour
+void DetectObjects(const Mat &src, HSV** FiltersParams, int HowManyColours, vector<Object> targets[])
+{
+   DetectWorkspace workspace;
+
+   DetectObjects(src, FiltersParams, HowManyColours, targets, workspace);
+   return;
+}
+
+// same as above, the intermediate images are kept in 'workspace' so that they are allocated only once
+void DetectObjects(const Mat &src, HSV** FiltersParams, int HowManyColours, vector<Object> targets[],
+                   DetectWorkspace &workspace)
+{
+   TRACE_SPAN("DetectObjects");
+   Mat &srcHSV = workspace.hsv, &filter = workspace.filter;
+   MaskLayout layout = workspace.kernel == DETECT_PACKED ? MASK_PACKED : MASK_SEPARATE;
+   HSVKernel kernel = workspace.kernel == DETECT_GENERIC ? NULL : SelectHSVKernel(HowManyColours, layout);
+   KernelBounds bounds;
+
+   {
+      TRACE_SPAN("cvtColor");
+      cvtColor(src, srcHSV, CV_BGR2HSV);   // convert the frame in the HSV colour space, once for all the colours
+   }
+
+   if (workspace.background != NULL)
+      workspace.background->beginFrame(src.size(), HowManyColours);
+
+   if ( kernel != NULL && SetKernelBounds(bounds, FiltersParams, HowManyColours) )
+   {
+      // all the colours in a single pass over the frame
+      workspace.masks.resize(layout == MASK_PACKED ? 1 : HowManyColours);
+      {
+         TRACE_SPAN("classifyHSV");
+         kernel(srcHSV, bounds, &workspace.masks[0]);
+      }
+
+      for( int i = 0; i < HowManyColours; i++ )
+      {
+         Mat &mask = layout == MASK_PACKED ? filter : workspace.masks[i];
+
+         if (layout == MASK_PACKED)
+         {
+            TRACE_SPAN("unpackMask", i);
+            UnpackMask(workspace.masks[0], i, filter);
+         }
+
+         if (workspace.background != NULL)
+         {
+            TRACE_SPAN("background", i);
+            workspace.background->apply(i, mask);
+         }
+
+         TRACE_SPAN("analyzeMask", i);
+         targets[i] = analyzeMask(mask, workspace.params);
+      }
+      return;
+   }
+
+   for( int i = 0; i < HowManyColours; i++ )
+   {
+      // filtering -> blurring -> Objects analysis
+      {
+         TRACE_SPAN("inRange", i);
+         inRange(srcHSV, Scalar( FiltersParams[0][i].hue, FiltersParams[0][i].sat, FiltersParams[0][i].val ),
+            Scalar( FiltersParams[1][i].hue, FiltersParams[1][i].sat, FiltersParams[1][i].val ), filter );
+      }
+      // filter now contains the binary that only displays the i-th colour.
+
+      if (workspace.background != NULL)
+      {
+         TRACE_SPAN("background", i);
+         workspace.background->apply(i, filter);
+      }
+
+      TRACE_SPAN("analyzeMask", i);
+      targets[i] = analyzeMask(filter, workspace.params);
+   }
 
    return;
 }
 //*********************************************************************************************************************
 
+//*********************************************************************************************************************
+// Filters are saved as a YAML/XML file (the extension decides), one min/max pair per colour
+bool SaveFilters(const char* path, HSV** FiltersParams, int HowManyColours)
+{
+   FileStorage fs(path, FileStorage::WRITE);
+
+   if ( !fs.isOpened() )
+      return false;
+
+   fs << "colours" << HowManyColours;
+   fs << "filters" << "[";
+   for (int i = 0; i < HowManyColours; i++)
+   {
+      fs << "{";
+      fs << "min" << "[" << FiltersParams[0][i].hue << FiltersParams[0][i].sat << FiltersParams[0][i].val << "]";
+      fs << "max" << "[" << FiltersParams[1][i].hue << FiltersParams[1][i].sat << FiltersParams[1][i].val << "]";
+      fs << "}";
+   }
+   fs << "]";
+
+   return true;
+}
+
+// returns NULL if the file can't be read. Free the result with FreeFilters()
+HSV** LoadFilters(const char* path, int &HowManyColours)
+{
+   HSV** FiltersParams = NULL;
+
+   // FileStorage throws on an empty or truncated file, e.g. one being saved in place while -LIVE watches it
+   try
+   {
+      FileStorage fs(path, FileStorage::READ);
+
+      if ( !fs.isOpened() )
+         return NULL;
+
+      FileNode filters = fs["filters"];
+      HowManyColours = (int)fs["colours"];
+      if ( HowManyColours <= 0 || (int)filters.size() != HowManyColours )
+         return NULL;
+
+      FiltersParams = AllocFilters(HowManyColours);
+      for (int i = 0; i < HowManyColours; i++)
+      {
+         FileNode min = filters[i]["min"], max = filters[i]["max"];
+
+         FiltersParams[0][i].hue = (int)min[0];  FiltersParams[0][i].sat = (int)min[1];  FiltersParams[0][i].val = (int)min[2];
+         FiltersParams[1][i].hue = (int)max[0];  FiltersParams[1][i].sat = (int)max[1];  FiltersParams[1][i].val = (int)max[2];
+      }
+   }
+   catch (const cv::Exception &)
+   {
+      FreeFilters(FiltersParams);
+      return NULL;
+   }
+
+   return FiltersParams;
+}
+
+// optional keys of the filters file: 'min_area' and 'morph_size'. The missing ones are left as they are.
+// Returns false if the file can't be read or the values are out of range (params is then unchanged)
+bool LoadDetectParams(const char* path, DetectParams &params)
+{
+   DetectParams loaded = params;
+
+   try   // same as LoadFilters()
+   {
+      FileStorage fs(path, FileStorage::READ);
+
+      if ( !fs.isOpened() )
+         return false;
+
+      if ( !fs["min_area"].empty() )
+         loaded.minArea = (double)fs["min_area"];
+      if ( !fs["morph_size"].empty() )
+         loaded.morphSize = (int)fs["morph_size"];
+   }
+   catch (const cv::Exception &)
+   {
+      return false;
+   }
+
+   if ( !loaded.valid() )
+      return false;
+
+   params = loaded;
+   return true;
+}
+//*********************************************************************************************************************
+
 //*********************************************************************************************************************
 void createTrackbarsForHSVSel(HSV* min, HSV* max)
 {
@@ -284,6 +667,19 @@ void createTrackbarsForHSVSel(HSV* min, HSV* max)
 
    return;
 }
+
+// moves the trackbars created by createTrackbarsForHSVSel() (their variables follow)
+void setTrackbarsForHSVSel(HSV min, HSV max)
+{
+   cv::setTrackbarPos("Low  hue", "Trackbars", min.hue);
+   cv::setTrackbarPos("High hue", "Trackbars", max.hue);
+   cv::setTrackbarPos("Low  sat", "Trackbars", min.sat);
+   cv::setTrackbarPos("High sat", "Trackbars", max.sat);
+   cv::setTrackbarPos("Low  val", "Trackbars", min.val);
+   cv::setTrackbarPos("High val", "Trackbars", max.val);
+
+   return;
+}
 //*********************************************************************************************************************
 
 //*********************************************************************************************************************
@@ -312,18 +708,19 @@ void findAndDrawRect(std::vector<std::vector<cv::Point> > contours, cv::Size dra
 //*********************************************************************************************************************
 
 //*********************************************************************************************************************
-void morphOps(Mat &thresh)
+void morphOps(Mat &thresh, int size)
 {
    // create structuring element that will be used to "dilate" and "erode" image.
-   // the element chosen here is a 3px by 3px rectangle.
+   // the element chosen here is a size x size rectangle (3px by 3px by default).
    // As a rule of thumb you want to dilate with larger element to make sure the object is nicely visible
    // but I actually found that often time this is not the case.
+   Mat element = getStructuringElement( MORPH_RECT, Size(size,size) );
 
-   erode ( thresh,thresh,getStructuringElement( MORPH_RECT, Size(3,3)) );
-   dilate( thresh,thresh,getStructuringElement( MORPH_RECT, Size(3,3)) );
+   erode ( thresh,thresh,element );
+   dilate( thresh,thresh,element );
 
-   dilate( thresh,thresh,getStructuringElement( MORPH_RECT, Size(3,3)) );
-   erode ( thresh,thresh,getStructuringElement( MORPH_RECT, Size(3,3)) );
+   dilate( thresh,thresh,element );
+   erode ( thresh,thresh,element );
 
    return ; 
 }
@@ -332,7 +729,7 @@ void morphOps(Mat &thresh)
 //*********************************************************************************************************************
 // returns all the objects found in the image by analysing its contours.
 // image should be previously treated with the Canny function for better results.
-vector<Object> analyzeContours(Mat image)
+vector<Object> analyzeContours(Mat image, double minArea, int maxObjects)
 {
    vector<vector<Point> > contours;
    vector<Vec4i> hierarchy;
@@ -357,25 +754,26 @@ vector<Object> analyzeContours(Mat image)
    if (hierarchy.size() > 0)
    {
       int numObjects = hierarchy.size();
-      // if numObjects > MAX_NUM_OBJECTS we have a noisy filter
+      // if numObjects > maxObjects we have a noisy filter
       
       // Code written by Kyle Hounslow and modified by Ahmad Kaifi & Hassan Althobaiti
-      if(numObjects < MAX_NUM_OBJECTS)
+      if(numObjects < maxObjects)
       {
          for(int index = 0; index >= 0; index = hierarchy[index][0])
          {
             moment = moments( (Mat)contours[index] );
             objectArea = moment.m00;
-            //if the area is less than 20 px by 20px then it is probably just noise
+            //if the area is less than minArea (20 px by 20px by default) then it is probably just noise
             //if the area is the same as the 3/2 of the image size, probably just a bad filter
             //we only want the object with the largest area so we safe a reference area each
             //iteration and compare it to the area in the next iteration.
-            if(objectArea > MIN_OBJECT_AREA)
+            if(objectArea > minArea)
             {
                // find the centroid of the image as by definition
-               // Centroid (x, y) = (m10/m00, m01/m00)
-               tempObject.setXCenter(moment.m10/objectArea);
-               tempObject.setYCenter(moment.m01/objectArea);
+               // Centroid (x, y) = (m10/m00, m01/m00), kept with its sub-pixel part
+               tempObject.setCenter( Point2f(moment.m10/objectArea, moment.m01/objectArea) );
+               // orientation, size and shape come from the same moments (plus the contour length)
+               classifyShape(moment, arcLength(contours[index], true), tempObject);
 
                object.push_back(tempObject);
 
@@ -400,8 +798,113 @@ vector<Object> analyzeContours(Mat image)
 }
 //*********************************************************************************************************************
 
+//*********************************************************************************************************************
+// Guesses the shape of a blob from its moments and perimeter, without fitting anything to the contour.
+// The second order central moments give the covariance of the blob. A rectangle and an ellipse with that same
+// covariance are computed and their area and perimeter are compared with the blob ones: the hypothesis with
+// the smallest relative error wins, unless both are off by more than SHAPE_MAX_ERROR (then it's "other").
+// The covariance also gives the orientation of the blob and the sides of the equivalent rectangle.
+void classifyShape(const Moments &moment, double perimeter, Object &object)
+{
+   double area = moment.m00;
+   double a = moment.mu20/area, b = moment.mu02/area, c = moment.mu11/area;
+
+   // eigenvalues of the covariance matrix [a c; c b]
+   double t  = sqrt(0.25*(a - b)*(a - b) + c*c);
+   double l1 = 0.5*(a + b) + t;
+   double l2 = max(0.5*(a + b) - t, 1e-9);
+
+   // a w x h rectangle has variances w^2/12 and h^2/12
+   double width = sqrt(12*l1), height = sqrt(12*l2);
+   double rectError = fabs(area/(width*height) - 1) + fabs(perimeter/(2*(width + height)) - 1);
+
+   // an ellipse with semi-axes p, q has variances p^2/4 and q^2/4. Perimeter from Ramanujan's approximation.
+   // The contour of a curved blob is a staircase, hence longer than the real perimeter: SHAPE_CURVED_PERIMETER
+   double p = 2*sqrt(l1), q = 2*sqrt(l2);
+   double ellipsePerimeter = CV_PI*(3*(p + q) - sqrt((3*p + q)*(p + 3*q)));
+   double ellipseError = fabs(area/(CV_PI*p*q) - 1) + fabs(perimeter/(SHAPE_CURVED_PERIMETER*ellipsePerimeter) - 1);
+
+   double best = min(rectError, ellipseError);
+
+   if (best > SHAPE_MAX_ERROR)
+      object.setShape(SHAPE_OTHER, min(1.0, best/SHAPE_MAX_ERROR - 1));
+   else
+      object.setShape(rectError < ellipseError ? SHAPE_RECTANGLE : SHAPE_CIRCLE, 1 - best/SHAPE_MAX_ERROR);
+
+   object.setAngle(0.5*atan2(2*c, a - b)*180/CV_PI);
+   object.setSize(Size2f(width, height));
+
+   return;
+}
+//*********************************************************************************************************************
+
+//*********************************************************************************************************************
+// cleans a binary image produced by the colour filtering and returns the objects found in it.
+// The mask is modified.
+vector<Object> analyzeMask(Mat &mask, const DetectParams &params)
+{
+   {
+      TRACE_SPAN("morphOps");
+      morphOps( mask, params.morphSize );
+   }
+
+   {
+      TRACE_SPAN("GaussianBlur");
+      GaussianBlur(mask, mask, Size(3,3), 0, 0);   // Kernel = 3x3, Sigmas are calculated automatically
+                                                   // (see 'getGaussianKernel()')
+   }
+
+   TRACE_SPAN("analyzeContours");
+   return analyzeContours(mask, params.minArea, params.maxObjects);
+}
+//*********************************************************************************************************************
+
+//*********************************************************************************************************************
+// pairs the objects of two lists (greedy nearest neighbour, the lists are short). Two objects match when their
+// centers are closer than 'tolerance' pixels. Returns the number of pairs, the largest distance goes in maxError
+int MatchObjects(const vector<Object> &a, const vector<Object> &b, double tolerance, double* maxError)
+{
+   vector<bool> used(b.size(), false);
+   int matched = 0;
+
+   for (size_t j = 0; j < a.size(); j++)
+   {
+      int best = -1;
+      double bestDist = tolerance;
+
+      for (size_t k = 0; k < b.size(); k++)
+      {
+         if (used[k])
+            continue;
+         double dx = a[j].getCenter().x - b[k].getCenter().x;   // sub-pixel: the int getters truncate
+         double dy = a[j].getCenter().y - b[k].getCenter().y;
+         double d = sqrt(dx*dx + dy*dy);
+         if (d <= bestDist)
+         {
+            best = k;
+            bestDist = d;
+         }
+      }
+
+      if (best >= 0)
+      {
+         used[best] = true;
+         matched++;
+         if (maxError != NULL && bestDist > *maxError)
+            *maxError = bestDist;
+      }
+   }
+
+   return matched;
+}
+//*********************************************************************************************************************
+
 void DrawObecjtCenter(Mat &image, Object object)
 {
-   circle(image, Point( object.getXCenter(), object.getYCenter() ), 10, Scalar(255,0,0), 1, 8);
+   // blue: rectangle (or unknown), green: circle/ellipse, red: anything else
+   Scalar colour = object.getShape() == SHAPE_CIRCLE ? Scalar(0,255,0) :
+                   object.getShape() == SHAPE_OTHER  ? Scalar(0,0,255) : Scalar(255,0,0);
+
+   circle(image, Point( object.getXCenter(), object.getYCenter() ), 10, colour, 1, 8);
    return;
 }
\ No newline at end of file
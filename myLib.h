@@ -1,3 +1,6 @@
+#ifndef MYLIB_H
+#define MYLIB_H
+
 #include <opencv/highgui.h>
 #include <opencv/cv.h>
 #include "object.h"
@@ -11,6 +14,14 @@
 
 #define MAX_NUM_OBJECTS 50
 #define MIN_OBJECT_AREA 20*20
+#define MORPH_SIZE      3       // side of the structuring element of morphOps()
+#define MORPH_MAX_SIZE  31
+
+#define SETUP_TIGHTEN_KEEP 0.95   // fraction of the pixels kept when the setup shrinks a filter automatically
+
+// Shape classification (see classifyShape())
+#define SHAPE_MAX_ERROR         0.12   // above this relative error the blob is neither a rectangle nor an ellipse
+#define SHAPE_CURVED_PERIMETER  1.03   // how much longer than the real one the contour of a curved blob is
 
 
 // Type definitions and functions prototypes
@@ -19,11 +30,79 @@ struct HSV
    int hue, sat, val;
 };
 
-void morphOps(cv::Mat &thresh);
+inline bool operator==(const HSV &a, const HSV &b) { return a.hue == b.hue && a.sat == b.sat && a.val == b.val; }
+inline bool operator!=(const HSV &a, const HSV &b) { return !(a == b); }
+
+// Classification step of DetectObjects() (see kernels.h)
+enum DetectKernel
+{
+   DETECT_SPECIALISED,   // kernel specialised on the number of colours, one mask per colour
+   DETECT_PACKED,        // same, all the colours in one mask
+   DETECT_GENERIC        // one inRange() per colour
+};
+
+// Settings of the blob analysis. They can be changed while sensing (see liveconfig.h)
+struct DetectParams
+{
+   double minArea;   // blobs up to this area (pixels) are noise
+   int morphSize;    // side of the structuring element of morphOps(), 1 to MORPH_MAX_SIZE
+   int maxObjects;   // a mask with this many contours or more is a noisy filter: nothing is detected in it
+
+   DetectParams() : minArea(MIN_OBJECT_AREA), morphSize(MORPH_SIZE), maxObjects(MAX_NUM_OBJECTS) {}
+   bool valid() const { return minArea >= 0 && morphSize >= 1 && morphSize <= MORPH_MAX_SIZE && maxObjects >= 1; }
+};
+
+class BackgroundModel;
+
+// Intermediate images of DetectObjects(), reused from one frame to the next
+struct DetectWorkspace
+{
+   cv::Mat hsv, filter;
+   std::vector<cv::Mat> masks;
+   DetectKernel kernel;          // the generic one is used anyway when there is no specialisation
+   BackgroundModel* background;  // optional: static clutter removed from the masks (see bgmodel.h)
+   DetectParams params;          // given to analyzeMask()
+
+   DetectWorkspace() : kernel(DETECT_SPECIALISED), background(NULL) {}
+};
+
+// Optional features of SensingMode()
+struct SensingOptions
+{
+   const char* recordPath;    // record the session here (see record.h)
+   const char* filtersPath;   // load the filters from here instead of running InitialSetup(). If the file
+                              // can't be loaded the setup is run as usual and its result is saved here
+   bool yuv;                  // ask the camera for raw YUV frames and classify them without conversions (see yuv.h)
+   const char* worldPath;     // calibration saved by -CALIBRATE: the objects get their position on the work
+                              // plane in millimetres (see calib.h)
+   bool background;           // learn the static clutter of the scene and ignore it (see bgmodel.h)
+   bool live;                 // reload filtersPath whenever it changes, without stopping (see liveconfig.h)
+   int controlPort;           // UDP port taking filter and parameter updates, 0 for none (see liveconfig.h)
+   const char* controlAddress;   // IPv4 address the control port is bound to, NULL for the loopback only
+
+   SensingOptions() : recordPath(NULL), filtersPath(NULL), yuv(false), worldPath(NULL), background(false), live(false),
+                      controlPort(0), controlAddress(NULL) {}
+};
+
+void morphOps(cv::Mat &thresh, int size = MORPH_SIZE);
+HSV** AllocFilters(int N);
+void FreeFilters(HSV** FiltersParams);
 HSV** InitialSetup(int N);
 void DebugMode();
-void SensingMode(int HowManyColours);
+void SensingMode(int HowManyColours, const SensingOptions &options = SensingOptions());
+void DetectObjects(const Mat &src, HSV** FiltersParams, int HowManyColours, vector<Object> targets[]);
+void DetectObjects(const Mat &src, HSV** FiltersParams, int HowManyColours, vector<Object> targets[],
+                   DetectWorkspace &workspace);
+bool SaveFilters(const char* path, HSV** FiltersParams, int HowManyColours);
+HSV** LoadFilters(const char* path, int &HowManyColours);
+bool LoadDetectParams(const char* path, DetectParams &params);
 void createTrackbarsForHSVSel(HSV* min, HSV* max);
+void setTrackbarsForHSVSel(HSV min, HSV max);
 void findAndDrawRect(std::vector<std::vector<cv::Point> >, cv::Size);
-vector<Object> analyzeContours(Mat image);
-void DrawObecjtCenter(Mat &image, Object object);
\ No newline at end of file
+vector<Object> analyzeContours(Mat image, double minArea = MIN_OBJECT_AREA, int maxObjects = MAX_NUM_OBJECTS);
+void classifyShape(const Moments &moment, double perimeter, Object &object);
+vector<Object> analyzeMask(Mat &mask, const DetectParams &params = DetectParams());
+int MatchObjects(const vector<Object> &a, const vector<Object> &b, double tolerance, double* maxError = NULL);
+void DrawObecjtCenter(Mat &image, Object object);
+
+#endif
@@ -2,9 +2,10 @@
    Yet to be completed!
 */
 
+#include <math.h>
 #include "object.h"
 
-Object::Object(void)
+Object::Object(void) : center(0, 0), angle(0), size(0, 0), shape(SHAPE_UNKNOWN), shapeConfidence(0), mapped(false)
 {
 }
 
@@ -12,27 +13,37 @@ Object::~Object(void)
 {
 }
 
-int Object::getXCenter()
+int Object::getXCenter() const
 {
-   return Object::xCenter;
+   return (int)Object::center.x;
 }
 
-int Object::getYCenter()
+int Object::getYCenter() const
 {
-   return Object::yCenter;
+   return (int)Object::center.y;
 }
 
 void Object::setXCenter(int x)
 {
-	Object::xCenter = x;
+	Object::center.x = x;
 }
 
 void Object::setYCenter(int y)
 {
-	Object::yCenter = y;
+	Object::center.y = y;
 }
 
-Scalar Object::getAvgColour()
+Point2f Object::getCenter() const
+{
+	return Object::center;
+}
+
+void Object::setCenter(Point2f center)
+{
+	Object::center = center;
+}
+
+Scalar Object::getAvgColour() const
 {
 	return Object::AvgColour;
 }
@@ -41,4 +52,77 @@ void Object::setAvgColour(Scalar min, Scalar max)
 {
 	// Object::AvgColour = AvgColour( 0.5*abs(max.v0 - min.v0), 0.5*abs(max.v1 - min.v1), 0.5*abs(max.v2 - min.v2) );
 	// right now this does not work because the Scalar type is not as easy as it looks
-}
\ No newline at end of file
+}
+
+float Object::getAngle() const
+{
+	return Object::angle;
+}
+
+void Object::setAngle(float angle)
+{
+	Object::angle = angle;
+}
+
+Size2f Object::getSize() const
+{
+	return Object::size;
+}
+
+void Object::setSize(Size2f size)
+{
+	Object::size = size;
+}
+
+ObjectShape Object::getShape() const
+{
+	return Object::shape;
+}
+
+float Object::getShapeConfidence() const
+{
+	return Object::shapeConfidence;
+}
+
+void Object::setShape(ObjectShape shape, float confidence)
+{
+	Object::shape = shape;
+	Object::shapeConfidence = confidence;
+}
+
+void Object::getCorners(Point2f corners[4]) const
+{
+	RotatedRect(Object::center, Object::size, Object::angle).points(corners);
+}
+
+bool Object::isMapped() const
+{
+	return Object::mapped;
+}
+
+Point2f Object::getWorldCenter() const
+{
+	return Object::worldCenter;
+}
+
+void Object::getWorldCorners(Point2f corners[4]) const
+{
+	for (int k = 0; k < 4; k++)
+		corners[k] = Object::worldCorners[k];
+}
+
+float Object::getWorldAngle() const
+{
+	// corners 1 -> 2 run along the width, i.e. the major axis
+	Point2f axis = Object::worldCorners[2] - Object::worldCorners[1];
+
+	return (float)(atan2(axis.y, axis.x)*180/CV_PI);
+}
+
+void Object::setWorld(Point2f center, const Point2f corners[4])
+{
+	Object::worldCenter = center;
+	for (int k = 0; k < 4; k++)
+		Object::worldCorners[k] = corners[k];
+	Object::mapped = true;
+}
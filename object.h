@@ -13,25 +13,66 @@
 using namespace std;
 using namespace cv;
 
+// Shape of the blob, as guessed by analyzeContours() from its moments
+enum ObjectShape
+{
+   SHAPE_UNKNOWN = 0,
+   SHAPE_RECTANGLE,
+   SHAPE_CIRCLE,      // circles and ellipses
+   SHAPE_OTHER        // cables, shadows, merged blobs...
+};
+
 class Object
 {
    public: 
       Object(void);
       ~Object(void);
 
-      int getXCenter();
-      int getYCenter();
+      int getXCenter() const;
+      int getYCenter() const;
 
       void setXCenter(int x);
       void setYCenter(int y);
 
-      Scalar getAvgColour();
+      // centroid with its sub-pixel part (the two above are the same point, truncated)
+      Point2f getCenter() const;
+      void setCenter(Point2f center);
+
+      Scalar getAvgColour() const;
       void setAvgColour(Scalar min, Scalar max);
 
+      // orientation of the major axis in degrees (same convention as cv::RotatedRect)
+      float getAngle() const;
+      void setAngle(float angle);
+
+      // sides of the rectangle with the same second order moments as the blob
+      Size2f getSize() const;
+      void setSize(Size2f size);
+
+      ObjectShape getShape() const;
+      float getShapeConfidence() const;   // 0..1
+      void setShape(ObjectShape shape, float confidence);
+
+      // corners of the rectangle given by center, size and angle (same order as cv::RotatedRect::points())
+      void getCorners(Point2f corners[4]) const;
+
+      // position on the work plane in millimetres, filled by CameraCalibration::mapObjects() (see calib.h)
+      bool isMapped() const;
+      Point2f getWorldCenter() const;
+      void getWorldCorners(Point2f corners[4]) const;
+      float getWorldAngle() const;   // degrees, major axis measured in the world frame
+      void setWorld(Point2f center, const Point2f corners[4]);
+
    private:
       int corners;
-      int xCenter, yCenter;
+      Point2f center;
       Scalar AvgColour;
+      float angle;
+      Size2f size;
+      ObjectShape shape;
+      float shapeConfidence;
+      bool mapped;
+      Point2f worldCenter, worldCorners[4];
 };
 
 #endif
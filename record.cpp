@@ -0,0 +1,730 @@
+/*
+   Record/replay of the sensing pipeline. See record.h for the file layout.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <iostream>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "record.h"
+#include "yuv.h"
+#include "trace.h"
+
+using namespace std;
+using namespace cv;
+
+int64_t NowMicroseconds()
+{
+   return (int64_t)( getTickCount() * 1e6 / getTickFrequency() );
+}
+
+//*********************************************************************************************************************
+Recorder::Recorder(void) : file(NULL), encoding(REC_ENCODING_RAW), offset(0), queuedFrames(0), stopping(false),
+                           failed(false), dropped(0)
+{
+}
+
+Recorder::~Recorder(void)
+{
+   close();
+}
+
+bool Recorder::open(const string &path, RecEncoding enc, bool threaded)
+{
+   RecFileHeader header;
+
+   close();
+
+   file = fopen(path.c_str(), "wb");
+   if (file == NULL)
+      return false;
+
+   header.magic      = REC_FILE_MAGIC;
+   header.version    = REC_VERSION;
+   header.headerSize = sizeof(RecFileHeader);
+   header.reserved   = 0;
+
+   if (fwrite(&header, sizeof(header), 1, file) != 1)
+   {
+      fclose(file);
+      file = NULL;
+      return false;
+   }
+
+   encoding = enc;
+   offset   = sizeof(header);
+   index.clear();
+
+   queuedFrames = 0;
+   stopping = failed = false;
+   dropped  = 0;
+   if (threaded)
+      writer = thread(&Recorder::run, this);
+
+   return true;
+}
+
+bool Recorder::write(uint64_t frameId, int64_t timestampUs, const Mat &frame,
+                     HSV** FiltersParams, int HowManyColours, const vector<Object> targets[],
+                     const DetectParams &params, RecPixels pixels)
+{
+   RecPending pending;
+   RecChunkHeader &chunk = pending.chunk;
+   bool withFrame;
+
+   if (file == NULL)
+      return false;
+
+   for (int i = 0; i < HowManyColours; i++)
+      for (size_t j = 0; j < targets[i].size(); j++)
+      {
+         Object o = targets[i][j];
+         RecObject r;
+         Point2f corners[4];
+
+         r.colour  = i;
+         r.xCenter = o.getCenter().x;
+         r.yCenter = o.getCenter().y;
+         r.angle   = o.getAngle();
+         r.width   = o.getSize().width;
+         r.height  = o.getSize().height;
+         r.shape   = o.getShape();
+         r.shapeConfidence = o.getShapeConfidence();
+         r.mapped  = o.isMapped();
+         r.worldX  = o.getWorldCenter().x;
+         r.worldY  = o.getWorldCenter().y;
+         o.getWorldCorners(corners);
+         for (int k = 0; k < 4; k++)
+         {
+            r.worldCorners[2*k]     = corners[k].x;
+            r.worldCorners[2*k + 1] = corners[k].y;
+         }
+         pending.objects.push_back(r);
+      }
+
+   for (int k = 0; k < 2; k++)
+      pending.filters.insert(pending.filters.end(), FiltersParams[k], FiltersParams[k] + HowManyColours);
+
+   memset(&chunk, 0, sizeof(chunk));
+   chunk.magic       = REC_CHUNK_MAGIC;
+   chunk.frameId     = frameId;
+   chunk.timestampUs = timestampUs;
+   chunk.encoding    = frame.empty() ? REC_ENCODING_NONE : encoding;
+   if (chunk.encoding == REC_ENCODING_PNG && frame.channels() == 2)
+      chunk.encoding = REC_ENCODING_RAW;   // packed YUYV, PNG has no 2 channel format
+   chunk.numColours  = HowManyColours;
+   chunk.numObjects  = pending.objects.size();
+   chunk.objectSize  = sizeof(RecObject);
+   chunk.minArea     = params.minArea;
+   chunk.morphSize   = params.morphSize;
+   chunk.pixels      = pixels;   // cleared by store() when no frame is stored
+
+   if (!writer.joinable())
+   {
+      pending.frame = frame;
+      return store(pending);
+   }
+
+   // only this thread adds frames to the queue: there is still room after the lock is released
+   {
+      lock_guard<mutex> guard(lock);
+
+      if (failed)
+         return false;
+      withFrame = chunk.encoding != REC_ENCODING_NONE && queuedFrames < REC_QUEUE_FRAMES;
+      if (chunk.encoding != REC_ENCODING_NONE && !withFrame)
+      {
+         chunk.encoding = REC_ENCODING_NONE;
+         dropped++;
+      }
+   }
+
+   if (withFrame)
+   {
+      TRACE_SPAN("copyFrame");
+      pending.frame = frame.clone();   // the caller draws on it right after
+   }
+
+   {
+      lock_guard<mutex> guard(lock);
+
+      queue.push_back(pending);
+      queuedFrames += withFrame;
+   }
+   queued.notify_one();
+
+   return true;
+}
+
+bool Recorder::store(RecPending &pending)
+{
+   RecChunkHeader &chunk = pending.chunk;
+   const Mat &frame = pending.frame;
+   const uchar* frameData = NULL;
+   Mat continuous;
+
+   if (chunk.encoding != REC_ENCODING_NONE)
+   {
+      chunk.rows   = frame.rows;
+      chunk.cols   = frame.cols;
+      chunk.type   = frame.type();
+   }
+   else
+      chunk.pixels = REC_PIXELS_BGR;
+
+   if (chunk.encoding == REC_ENCODING_RAW)
+   {
+      continuous = frame.isContinuous() ? frame : frame.clone();
+      frameData = continuous.data;
+      chunk.frameBytes = continuous.total() * continuous.elemSize();
+   }
+   else if (chunk.encoding == REC_ENCODING_PNG)
+   {
+      vector<int> pngParams;
+      pngParams.push_back(CV_IMWRITE_PNG_COMPRESSION);
+      pngParams.push_back(1);   // "lightly" compressed: ~2x smaller than raw, cheap enough for real time
+
+      imencode(".png", frame, buffer, pngParams);
+      frameData = buffer.empty() ? NULL : &buffer[0];
+      chunk.frameBytes = buffer.size();
+   }
+
+   chunk.chunkSize = sizeof(chunk) + chunk.frameBytes + pending.filters.size()*sizeof(HSV) +
+                     pending.objects.size()*sizeof(RecObject);
+
+   // header, frame, filters (all the minimums then all the maximums), objects
+   bool ok = fwrite(&chunk, sizeof(chunk), 1, file) == 1;
+   if (ok && chunk.frameBytes > 0)
+      ok = fwrite(frameData, 1, chunk.frameBytes, file) == chunk.frameBytes;
+   if (ok && !pending.filters.empty())
+      ok = fwrite(&pending.filters[0], sizeof(HSV), pending.filters.size(), file) == pending.filters.size();
+   if (ok && !pending.objects.empty())
+      ok = fwrite(&pending.objects[0], sizeof(RecObject), pending.objects.size(), file) == pending.objects.size();
+
+   if (!ok)
+      return false;
+
+   index.push_back(offset);
+   offset += chunk.chunkSize;
+
+   return true;
+}
+
+// the writer thread: stores the chunks in order, then leaves once asked to and the queue is empty
+void Recorder::run()
+{
+   TraceSetThreadName("recorder");
+
+   while (true)
+   {
+      RecPending pending;
+
+      {
+         unique_lock<mutex> guard(lock);
+         while (queue.empty() && !stopping)
+            queued.wait(guard);
+         if (queue.empty())
+            return;
+
+         pending = queue.front();
+         queue.pop_front();
+      }
+
+      bool ok;
+      {
+         TRACE_SPAN("storeChunk");
+         ok = store(pending);
+      }
+
+      {
+         lock_guard<mutex> guard(lock);
+         queuedFrames -= !pending.frame.empty();
+         failed = failed || !ok;
+      }
+   }
+}
+
+void Recorder::close()
+{
+   RecFileFooter footer;
+
+   if (file == NULL)
+      return;
+
+   if (writer.joinable())
+   {
+      {
+         lock_guard<mutex> guard(lock);
+         stopping = true;
+      }
+      queued.notify_one();
+      writer.join();
+   }
+
+   footer.indexOffset = offset;
+   footer.frameCount  = index.size();
+   footer.magic       = REC_FOOTER_MAGIC;
+   footer.reserved    = 0;
+
+   if (!index.empty())
+      fwrite(&index[0], sizeof(uint64_t), index.size(), file);
+   fwrite(&footer, sizeof(footer), 1, file);
+
+   fclose(file);
+   file = NULL;
+   index.clear();
+}
+//*********************************************************************************************************************
+
+//*********************************************************************************************************************
+Player::Player(void) : data(NULL), length(0), chunkHeaderSize(sizeof(RecChunkHeader))
+{
+}
+
+Player::~Player(void)
+{
+   close();
+}
+
+bool Player::open(const string &path)
+{
+   struct stat st;
+   RecFileHeader header;
+   RecFileFooter footer;
+
+   close();
+
+   int fd = ::open(path.c_str(), O_RDONLY);
+   if (fd < 0)
+      return false;
+
+   if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(RecFileHeader))
+   {
+      ::close(fd);
+      return false;
+   }
+
+   length = st.st_size;
+   void* map = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+   ::close(fd);   // the mapping stays valid after closing the descriptor
+
+   if (map == MAP_FAILED)
+   {
+      length = 0;
+      return false;
+   }
+   data = (const uchar*)map;
+
+   memcpy(&header, data, sizeof(header));
+   if (header.magic != REC_FILE_MAGIC || header.version > REC_VERSION)
+   {
+      close();
+      return false;
+   }
+   chunkHeaderSize = header.version >= 5 ? sizeof(RecChunkHeader) :
+                     header.version == 4 ? REC_CHUNK_HEADER_V4 : REC_CHUNK_HEADER_V3;
+
+   // Look for the trailing index first, fall back to a linear scan if the recording was not closed
+   if (length >= sizeof(RecFileHeader) + sizeof(RecFileFooter))
+   {
+      memcpy(&footer, data + length - sizeof(footer), sizeof(footer));
+
+      // frameCount is checked first so that the product can't wrap around
+      if (footer.magic == REC_FOOTER_MAGIC && footer.frameCount <= length/sizeof(uint64_t) &&
+          footer.indexOffset + footer.frameCount*sizeof(uint64_t) + sizeof(footer) == length)
+      {
+         RecChunkHeader chunk;
+         bool valid = true;
+
+         index.resize(footer.frameCount);
+         if (footer.frameCount > 0)
+            memcpy(&index[0], data + footer.indexOffset, footer.frameCount*sizeof(uint64_t));
+
+         // a damaged index is dropped as a whole, the scan below finds what is still readable
+         for (size_t i = 0; i < index.size() && valid; i++)
+            valid = chunkAt(index[i], chunk) && index[i] + chunk.chunkSize <= footer.indexOffset;
+         if (valid)
+            return true;
+      }
+   }
+
+   return rebuildIndex();
+}
+
+// the header of the chunk at 'p', completed with what older versions did not store
+static void ReadChunkHeader(const uchar* p, size_t headerSize, RecChunkHeader &chunk)
+{
+   DetectParams defaults;   // what the recordings were made with before version 4
+
+   memcpy(&chunk, p, headerSize);
+   if (headerSize < REC_CHUNK_HEADER_V4)
+   {
+      chunk.minArea   = defaults.minArea;
+      chunk.morphSize = defaults.morphSize;
+   }
+   if (headerSize < sizeof(RecChunkHeader))   // the best guess from the geometry, as the replay used to do
+   {
+      if (chunk.type == CV_8UC2)
+         chunk.pixels = REC_PIXELS_YUYV;
+      else if (chunk.type == CV_8UC1 && chunk.rows % 3 == 0)
+         chunk.pixels = REC_PIXELS_NV12;
+      else
+         chunk.pixels = REC_PIXELS_BGR;
+   }
+}
+
+bool Player::rebuildIndex()
+{
+   RecFileHeader header;
+   RecChunkHeader chunk;
+   uint64_t pos;
+
+   memcpy(&header, data, sizeof(header));
+   pos = header.headerSize;
+
+   index.clear();
+   while (chunkAt(pos, chunk))   // up to a truncated or damaged chunk: everything before it is still usable
+   {
+      index.push_back(pos);
+      pos += chunk.chunkSize;
+   }
+
+   return true;
+}
+
+void Player::close()
+{
+   if (data != NULL)
+      munmap((void*)data, length);
+
+   data   = NULL;
+   length = 0;
+   index.clear();
+}
+
+bool Player::chunkAt(uint64_t pos, RecChunkHeader &chunk) const
+{
+   if (pos > length || length - pos < chunkHeaderSize)
+      return false;
+
+   ReadChunkHeader(data + pos, chunkHeaderSize, chunk);
+   if (chunk.magic != REC_CHUNK_MAGIC || chunk.chunkSize < chunkHeaderSize || chunk.chunkSize > length - pos)
+      return false;
+
+   // all on 64 bits: the 32 bit counts of a damaged header can't overflow them
+   uint64_t content = (uint64_t)chunkHeaderSize + chunk.frameBytes + 2*(uint64_t)chunk.numColours*sizeof(HSV) +
+                      (uint64_t)chunk.numObjects*chunk.objectSize;
+   if (content > chunk.chunkSize || chunk.pixels < REC_PIXELS_BGR || chunk.pixels > REC_PIXELS_NV12)
+      return false;
+
+   // a raw frame is mapped as it is: its geometry must match the bytes stored
+   if (chunk.encoding == REC_ENCODING_RAW)
+      return chunk.rows > 0 && chunk.cols > 0 && CV_MAT_TYPE(chunk.type) == chunk.type &&
+             (uint64_t)chunk.rows*chunk.cols*CV_ELEM_SIZE(chunk.type) == chunk.frameBytes;
+
+   return true;
+}
+
+bool Player::read(size_t i, RecFrame &out) const
+{
+   RecChunkHeader chunk;
+   const uchar* p;
+
+   if (i >= index.size() || !chunkAt(index[i], chunk))
+      return false;
+
+   p = data + index[i] + chunkHeaderSize;
+
+   out.frameId     = chunk.frameId;
+   out.timestampUs = chunk.timestampUs;
+   out.params.minArea   = chunk.minArea;
+   out.params.morphSize = chunk.morphSize;
+   out.pixels           = (RecPixels)chunk.pixels;
+
+   if (chunk.encoding == REC_ENCODING_RAW)
+      out.frame = Mat(chunk.rows, chunk.cols, chunk.type, (void*)p);   // no copy, read only!
+   else if (chunk.encoding == REC_ENCODING_PNG)
+      out.frame = imdecode(Mat(1, chunk.frameBytes, CV_8UC1, (void*)p), CV_LOAD_IMAGE_UNCHANGED);
+   else
+      out.frame = Mat();
+   p += chunk.frameBytes;
+
+   out.min.resize(chunk.numColours);
+   out.max.resize(chunk.numColours);
+   if (chunk.numColours > 0)
+   {
+      memcpy(&out.min[0], p, chunk.numColours*sizeof(HSV));  p += chunk.numColours*sizeof(HSV);
+      memcpy(&out.max[0], p, chunk.numColours*sizeof(HSV));  p += chunk.numColours*sizeof(HSV);
+   }
+
+   out.targets.assign(chunk.numColours, vector<Object>());
+   for (uint32_t j = 0; j < chunk.numObjects; j++)
+   {
+      RecObject r;
+      Object o;
+
+      // copy only what we know of: newer writers may append fields to RecObject
+      memset(&r, 0, sizeof(r));
+      memcpy(&r, p + j*chunk.objectSize, std::min((size_t)chunk.objectSize, sizeof(r)));
+
+      if (r.colour < 0 || r.colour >= (int32_t)chunk.numColours)
+         continue;
+
+      o.setCenter( Point2f(r.xCenter, r.yCenter) );   // integer valued before version 3
+      o.setAngle(r.angle);
+      o.setSize(Size2f(r.width, r.height));
+      o.setShape((ObjectShape)r.shape, r.shapeConfidence);   // SHAPE_UNKNOWN in version 1 files
+      if (r.mapped)
+      {
+         Point2f corners[4];
+
+         for (int k = 0; k < 4; k++)
+            corners[k] = Point2f(r.worldCorners[2*k], r.worldCorners[2*k + 1]);
+         o.setWorld(Point2f(r.worldX, r.worldY), corners);
+      }
+      out.targets[r.colour].push_back(o);
+   }
+
+   return true;
+}
+//*********************************************************************************************************************
+
+//*********************************************************************************************************************
+// Feeds a recording through the pipeline, with the filters that were active when it was recorded.
+// At original speed the frames are shown and paced on their timestamps, at maximum speed nothing is shown
+// and the throughput is printed at the end. If outPath is given the new detections are recorded there
+// (frames are not stored again) so that they can be compared with DiffRecordings().
+void ReplayMode(const char* path, bool maxSpeed, const char* outPath)
+{
+   Player player;
+   Recorder recorder;
+   RecFrame rec;
+   Mat drawing;
+   DetectWorkspace workspace;
+   YUVClassifier classifier;
+   vector<Mat> masks;
+   vector<HSV> lastMin, lastMax;
+   int64_t start = 0, firstStamp = 0, busy = 0;
+   size_t processed = 0;   // the skipped frames are not in the throughput
+
+   if ( !player.open(path) )
+   {
+      cout << "Not able to open the recording " << path << endl;
+      return;
+   }
+
+   if ( outPath != NULL && !recorder.open(outPath, REC_ENCODING_NONE) )
+   {
+      cout << "Not able to open " << outPath << " for recording." << endl;
+      return;
+   }
+
+   TraceSetThreadName("replay");
+
+   for (size_t n = 0; n < player.size(); n++)
+   {
+      TraceSetFrame(n);
+      TRACE_SPAN("frame");
+
+      {
+         TRACE_SPAN("read");
+         if ( !player.read(n, rec) || rec.frame.empty() )
+            continue;
+      }
+
+      int HowManyColours = rec.min.size();
+      HSV* rows[2] = { HowManyColours > 0 ? &rec.min[0] : NULL, HowManyColours > 0 ? &rec.max[0] : NULL };
+      vector<Object> targets[HowManyColours > 0 ? HowManyColours : 1];
+
+      if (start == 0)
+      {
+         start = NowMicroseconds();
+         firstStamp = rec.timestampUs;
+      }
+
+      // raw YUV recordings (see yuv.h) are replayed through the YUV path, as they were processed live
+      bool yuvFrame = rec.pixels != REC_PIXELS_BGR;
+      YUVFormat format = rec.pixels == REC_PIXELS_YUYV ? YUV_FORMAT_YUYV : YUV_FORMAT_NV12;
+      Size size(rec.frame.cols, format == YUV_FORMAT_YUYV ? rec.frame.rows : rec.frame.rows*2/3);
+
+      if ( yuvFrame && (classifier.colours() != HowManyColours || rec.min != lastMin || rec.max != lastMax) )
+      {
+         classifier.build(rows, HowManyColours);
+         lastMin = rec.min;
+         lastMax = rec.max;
+      }
+
+      // the stored format must match the frame, a damaged chunk could say otherwise
+      bool expected = rec.pixels == REC_PIXELS_BGR  ? rec.frame.type() == CV_8UC3 :
+                      rec.pixels == REC_PIXELS_YUYV ? rec.frame.type() == CV_8UC2 && rec.frame.cols % 2 == 0 :
+                      rec.frame.type() == CV_8UC1 && rec.frame.rows % 3 == 0 && rec.frame.cols % 2 == 0;
+      if ( !expected )
+      {
+         cout << "Frame " << rec.frameId << " doesn't hold the pixel format it was recorded with (type "
+              << rec.frame.type() << "), skipped." << endl;
+         continue;
+      }
+
+      // with the settings of the live session, they may have changed along the way (see liveconfig.h)
+      workspace.params = rec.params;
+      if ( !rec.params.valid() )
+      {
+         cout << "Frame " << rec.frameId << " has invalid detection parameters, skipped." << endl;
+         continue;
+      }
+
+      int64_t t0 = NowMicroseconds();
+      if ( yuvFrame && !classifier.empty() )
+         DetectObjectsYUV(rec.frame, format, size, classifier, masks, targets, NULL, rec.params);
+      else if ( yuvFrame )   // too many colours for the lookup table: through BGR, as YUVTestMode() does
+      {
+         YUVToBGR(rec.frame, format, drawing);
+         DetectObjects(drawing, rows, HowManyColours, targets, workspace);
+      }
+      else
+         DetectObjects(rec.frame, rows, HowManyColours, targets, workspace);
+      busy += NowMicroseconds() - t0;
+      processed++;
+
+      if ( recorder.isOpen() )
+         recorder.write(rec.frameId, rec.timestampUs, Mat(), rows, HowManyColours, targets, rec.params);
+
+      if (!maxSpeed)
+      {
+         if (yuvFrame)
+            YUVToBGR(rec.frame, format, drawing);
+         else
+            rec.frame.copyTo(drawing);   // the frame may live in the (read only) mapped file
+         for (int i = 0; i < HowManyColours; i++)
+            for (size_t j = 0; j < targets[i].size(); j++)
+               DrawObecjtCenter(drawing, targets[i].at(j));
+         imshow("Replay", drawing);
+
+         // wait until the frame is due, but at least 1ms to let highgui draw
+         int64_t due = (rec.timestampUs - firstStamp) - (NowMicroseconds() - start);
+         if ( (char)waitKey( due > 1000 ? (int)(due/1000) : 1 ) == 'q' )
+            break;
+      }
+   }
+
+   if (player.size() > 0)
+      cout << processed << " frames processed, " << player.size() - processed << " skipped, pipeline time "
+           << busy/1000 << " ms (" << (busy > 0 ? processed*1e6/busy : 0) << " fps)" << endl;
+
+   recorder.close();
+   destroyAllWindows();
+   return;
+}
+//*********************************************************************************************************************
+
+//*********************************************************************************************************************
+static int CountObjects(const vector< vector<Object> > &targets)
+{
+   int count = 0;
+
+   for (size_t i = 0; i < targets.size(); i++)
+      count += targets[i].size();
+   return count;
+}
+
+// Compares the detections of two recordings of the same footage, frame by frame and colour by colour.
+// The frames are paired on their frameId: a frame missing from one of them (e.g. skipped by a replay)
+// counts once, the following ones are still compared. Two objects match when their centers are closer
+// than 'tolerance' pixels.
+// Returns the number of frames that do not match (0 means the recordings are equivalent).
+int DiffRecordings(const char* pathA, const char* pathB, double tolerance)
+{
+   Player a, b;
+   RecFrame ra, rb;
+   int badFrames = 0, missing = 0, extra = 0, matched = 0;
+   double maxError = 0;
+   size_t na = 0, nb = 0;
+   bool haveA = false, haveB = false;   // ra / rb hold frame na / nb, not paired yet
+
+   if ( !a.open(pathA) || !b.open(pathB) )
+   {
+      cout << "Not able to open the recordings." << endl;
+      return -1;
+   }
+
+   if (a.size() != b.size())
+      cout << "Different number of frames: " << a.size() << " vs " << b.size() << endl;
+
+   // both recordings are in frameId order
+   while ( na < a.size() || nb < b.size() )
+   {
+      bool sameFrame = true;
+
+      if ( !haveA && na < a.size() && !(haveA = a.read(na, ra)) )
+      {
+         cout << "Chunk " << na++ << " of " << pathA << ": unreadable" << endl;
+         badFrames++;
+         continue;
+      }
+      if ( !haveB && nb < b.size() && !(haveB = b.read(nb, rb)) )
+      {
+         cout << "Chunk " << nb++ << " of " << pathB << ": unreadable" << endl;
+         badFrames++;
+         continue;
+      }
+
+      if ( haveA && (!haveB || ra.frameId < rb.frameId) )
+      {
+         cout << "Frame " << ra.frameId << ": only in " << pathA << endl;
+         missing += CountObjects(ra.targets);
+         badFrames++;
+         haveA = false;
+         na++;
+         continue;
+      }
+      if ( haveB && (!haveA || rb.frameId < ra.frameId) )
+      {
+         cout << "Frame " << rb.frameId << ": only in " << pathB << endl;
+         extra += CountObjects(rb.targets);
+         badFrames++;
+         haveB = false;
+         nb++;
+         continue;
+      }
+
+      haveA = haveB = false;
+      na++;
+      nb++;
+
+      if ( ra.targets.size() != rb.targets.size() )
+      {
+         cout << "Frame " << ra.frameId << ": not comparable (different number of colours)" << endl;
+         badFrames++;
+         continue;
+      }
+
+      for (size_t i = 0; i < ra.targets.size(); i++)
+      {
+         int m = MatchObjects(ra.targets[i], rb.targets[i], tolerance, &maxError);
+
+         matched += m;
+         missing += ra.targets[i].size() - m;
+         extra   += rb.targets[i].size() - m;
+         if ( m != (int)ra.targets[i].size() || m != (int)rb.targets[i].size() )
+            sameFrame = false;
+      }
+
+      if (!sameFrame)
+      {
+         cout << "Frame " << ra.frameId << ": detections differ" << endl;
+         badFrames++;
+      }
+   }
+
+   cout << "Matched " << matched << " objects (max center error " << maxError << " px), "
+        << missing << " only in " << pathA << ", " << extra << " only in " << pathB << ", "
+        << badFrames << " frames differ." << endl;
+
+   return badFrames;
+}
+//*********************************************************************************************************************
@@ -0,0 +1,211 @@
+/*
+   Record/replay of the sensing pipeline.
+
+   A recording is a chunked, append-only file: one chunk per frame holding the frame itself (raw or
+   PNG-compressed) and its pixel format, its capture timestamp, the HSV filters and DetectParams active at that moment and the
+   objects found.
+   When the recording is closed a trailing index with the offset of every chunk is appended, so that
+   the player can seek to any frame in O(1). If the sensor dies before closing the file the index is
+   missing, in that case the player rebuilds it by walking the chunks once.
+
+   File layout (integers are stored in host byte order, the files are not meant to travel between
+   machines with different endianness):
+
+      RecFileHeader
+      RecChunkHeader + frame bytes + HSV[2*numColours] + RecObject[numObjects]     <- one per frame
+      ...
+      uint64 offsets[frameCount]                                                 <- trailing index
+      RecFileFooter
+*/
+
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <opencv/highgui.h>
+#include <opencv/cv.h>
+#include "myLib.h"
+#include "object.h"
+
+#define REC_FILE_MAGIC    0x31524356   // "VCR1"
+#define REC_CHUNK_MAGIC   0x454d5246   // "FRME"
+#define REC_FOOTER_MAGIC  0x58444e49   // "INDX"
+#define REC_QUEUE_FRAMES  8            // frames waiting for the writer thread of a threaded Recorder
+#define REC_VERSION       5   // 2: shape, orientation and size of the objects
+                              // 3: sub-pixel centers, position on the work plane (see calib.h)
+                              // 4: DetectParams in RecChunkHeader
+                              // 5: pixel format in RecChunkHeader
+
+enum RecEncoding
+{
+   REC_ENCODING_NONE = 0,   // no frame stored (detections only)
+   REC_ENCODING_RAW  = 1,   // frame stored as it is in memory, replay maps it without copies
+   REC_ENCODING_PNG  = 2    // lossless, fastest compression level
+};
+
+// What the pixels of a stored frame are. Before version 5 it was guessed from the Mat geometry, which
+// can't tell NV12 from a grey frame whose rows are a multiple of 3
+enum RecPixels
+{
+   REC_PIXELS_BGR  = 0,     // CV_8UC3, what VideoCapture returns by default
+   REC_PIXELS_YUYV = 1,     // raw camera frame, YUV_FORMAT_YUYV (see yuv.h)
+   REC_PIXELS_NV12 = 2      // raw camera frame, YUV_FORMAT_NV12
+};
+
+struct RecFileHeader
+{
+   uint32_t magic, version;
+   uint32_t headerSize;   // sizeof(RecFileHeader) as written, to allow future extensions
+   uint32_t reserved;
+};
+
+struct RecChunkHeader
+{
+   uint32_t magic;
+   uint32_t chunkSize;         // whole chunk, header included
+   uint64_t frameId;
+   int64_t  timestampUs;       // capture time in microseconds
+   int32_t  rows, cols, type;  // cv::Mat geometry of the stored frame
+   uint32_t encoding;          // RecEncoding
+   uint32_t frameBytes;
+   uint32_t numColours;
+   uint32_t numObjects;
+   uint32_t objectSize;        // sizeof(RecObject) as written
+   // version 4. Older files have a shorter header (REC_CHUNK_HEADER_V3) and used the defaults
+   float    minArea;           // DetectParams of the frame
+   int32_t  morphSize;
+   // version 5. Older files have a shorter header (REC_CHUNK_HEADER_V4)
+   int32_t  pixels;            // RecPixels of the stored frame
+   uint32_t reserved;
+};
+
+#define REC_CHUNK_HEADER_V3 offsetof(RecChunkHeader, minArea)
+#define REC_CHUNK_HEADER_V4 offsetof(RecChunkHeader, pixels)
+
+// Object as stored on disk. New fields go at the end: readers use RecChunkHeader::objectSize
+struct RecObject
+{
+   int32_t colour;        // index of the filter that found the object
+   float   xCenter, yCenter;
+   // version 2
+   float   angle, width, height;
+   int32_t shape;         // ObjectShape
+   float   shapeConfidence;
+   // version 3
+   int32_t mapped;        // 1 if the world fields are valid
+   float   worldX, worldY;         // millimetres on the work plane
+   float   worldCorners[8];        // x0, y0, ... x3, y3
+};
+
+struct RecFileFooter
+{
+   uint64_t indexOffset;
+   uint64_t frameCount;
+   uint32_t magic;
+   uint32_t reserved;
+};
+
+// One replayed frame. When the frame was stored raw, 'frame' points straight into the mapped file.
+struct RecFrame
+{
+   uint64_t frameId;
+   int64_t  timestampUs;
+   cv::Mat  frame;
+   RecPixels pixels;                           // what 'frame' holds, when not empty
+   std::vector<HSV> min, max;                  // active filters, one per colour
+   DetectParams params;                        // active when the frame was processed
+   std::vector<std::vector<Object> > targets;  // detections, divided by colour
+};
+
+
+// A chunk on its way to the file
+struct RecPending
+{
+   RecChunkHeader chunk;             // frameBytes and chunkSize are set when it is stored
+   cv::Mat frame;
+   std::vector<HSV> filters;         // all the minimums then all the maximums
+   std::vector<RecObject> objects;
+};
+
+class Recorder
+{
+   public:
+      Recorder(void);
+      ~Recorder(void);
+
+      // With 'threaded' the frames are encoded and written by a thread of its own and write() only copies
+      // them, so that recording doesn't change the timing of a live session. At most REC_QUEUE_FRAMES
+      // frames wait: when the encoder or the disk can't keep up, the chunk is stored without its frame
+      // (the detections are kept) and counted in droppedFrames()
+      bool open(const std::string &path, RecEncoding encoding, bool threaded = false);
+      // appends a chunk. 'frame' may be empty when encoding is REC_ENCODING_NONE. Threaded, false only
+      // when an earlier chunk could not be written
+      bool write(uint64_t frameId, int64_t timestampUs, const cv::Mat &frame,
+                 HSV** FiltersParams, int HowManyColours, const std::vector<Object> targets[],
+                 const DetectParams &params = DetectParams(), RecPixels pixels = REC_PIXELS_BGR);
+      // writes what is still queued, the trailing index and closes the file
+      void close();
+
+      bool isOpen() const { return file != NULL; }
+      uint64_t droppedFrames() const { return dropped; }   // of the last recording, once closed
+
+   private:
+      bool store(RecPending &pending);   // encodes and appends, in the writer thread when threaded
+      void run();
+
+      FILE* file;
+      RecEncoding encoding;
+      uint64_t offset;
+      std::vector<uint64_t> index;
+      std::vector<uchar> buffer;   // reused by the PNG encoder
+
+      // threaded only. Everything below is protected by 'lock'
+      std::thread writer;
+      std::mutex lock;
+      std::condition_variable queued;
+      std::deque<RecPending> queue;
+      int queuedFrames;            // chunks of the queue holding a frame
+      bool stopping, failed;
+      uint64_t dropped;
+};
+
+
+class Player
+{
+   public:
+      Player(void);
+      ~Player(void);
+
+      bool open(const std::string &path);
+      void close();
+
+      size_t size() const { return index.size(); }
+      // decodes the i-th frame. Returns false if the chunk is damaged
+      bool read(size_t i, RecFrame &out) const;
+
+   private:
+      bool rebuildIndex();
+      // reads the header of the chunk at 'pos'. False if it is damaged or its content does not fit in it
+      bool chunkAt(uint64_t pos, RecChunkHeader &chunk) const;
+
+      const uchar* data;
+      size_t length;
+      size_t chunkHeaderSize;   // depends on the version of the file
+      std::vector<uint64_t> index;
+};
+
+
+// Returns the current time in microseconds (same clock used to stamp the frames)
+int64_t NowMicroseconds();
+
+void ReplayMode(const char* path, bool maxSpeed, const char* outPath = NULL);
+int DiffRecordings(const char* pathA, const char* pathB, double tolerance);
+
+#endif
@@ -0,0 +1,157 @@
+/*
+   Synthetic scenes with exact ground truth. See synth.h.
+*/
+
+#include <math.h>
+#include "synth.h"
+
+using namespace std;
+using namespace cv;
+
+#define SYNTH_BACKGROUND  90    // grey level of the background (saturation 0, never matches a filter)
+#define SYNTH_SAT        230
+#define SYNTH_VAL        220
+
+SynthScene::SynthScene(const SynthParams &params) : p(params), rng(params.seed)
+{
+   int K = max(p.numObjects, 1);
+   int C = min(max(p.numColours, 1), SYNTH_MAX_COLOURS);
+   p.numColours = C;
+
+   // Hues evenly spaced and centered in their slot, so that no filter has to wrap around 0/179
+   for (int c = 0; c < C; c++)
+   {
+      Mat hsv(1, 1, CV_8UC3, Scalar((c + 0.5)*(MAX_HUE + 1)/C, SYNTH_SAT, SYNTH_VAL)), bgr;
+      cvtColor(hsv, bgr, CV_HSV2BGR);
+
+      Vec3b v = bgr.at<Vec3b>(0, 0);
+      hues.push_back((int)((c + 0.5)*(MAX_HUE + 1)/C));
+      palette.push_back(Scalar(v[0], v[1], v[2]));
+   }
+
+   // One object per cell of a grid: objects never overlap, even while moving, so the ground truth stays exact
+   double cell = sqrt((double)p.width*p.height/K);
+   int gridCols = max(1, (int)(p.width/cell)), gridRows = max(1, (int)ceil((double)K/gridCols));
+   double cellW = (double)p.width/gridCols, cellH = (double)p.height/gridRows;
+   double side = min(cellW, cellH);
+
+   // all the objects move along the same direction (think of a conveyor belt), so that one motion blur
+   // kernel is right for the whole frame
+   double direction = rng.uniform(0.0, CV_PI);
+
+   for (int k = 0; k < K; k++)
+   {
+      SynthObject o;
+      int gx = k % gridCols, gy = k / gridCols;
+
+      o.colour = k % C;
+      o.size   = Size2f(side*rng.uniform(0.40, 0.60), 0);
+      o.size.height = o.size.width*rng.uniform(0.5, 1.0);
+      o.angle  = rng.uniform(0.0, 180.0);
+      o.center = Point2f((gx + 0.5)*cellW + rng.uniform(-0.1, 0.1)*side, (gy + 0.5)*cellH + rng.uniform(-0.1, 0.1)*side);
+      o.velocity = Point2f(p.speed*cos(direction), p.speed*sin(direction));
+      objects.push_back(o);
+   }
+
+   background = Mat(p.height, p.width, CV_8UC3, Scalar::all(SYNTH_BACKGROUND));
+
+   // tape marks and the like: thin strips anywhere in the frame, objects included
+   for (int k = 0; k < p.clutter; k++)
+   {
+      Point2f center(rng.uniform(0.0, (double)p.width), rng.uniform(0.0, (double)p.height));
+      double length = min(p.width, p.height)*rng.uniform(0.1, 0.3), angle = rng.uniform(0.0, CV_PI);
+      Point2f half(0.5*length*cos(angle), 0.5*length*sin(angle));
+
+      line(background, center - half, center + half, palette[rng.uniform(0, C)], rng.uniform(4, 10), CV_AA);
+   }
+
+   if (p.lighting > 0)   // horizontal ramp from full brightness to (1 - lighting)
+   {
+      shading.create(p.height, p.width, CV_8UC3);
+      for (int x = 0; x < p.width; x++)
+         shading.col(x).setTo(Scalar::all(255*(1 - p.lighting*x/max(p.width - 1, 1))));
+   }
+}
+
+void SynthScene::move()
+{
+   int K = objects.size();
+   double cell = sqrt((double)p.width*p.height/K);
+   int gridCols = max(1, (int)(p.width/cell)), gridRows = max(1, (int)ceil((double)K/gridCols));
+   double cellW = (double)p.width/gridCols, cellH = (double)p.height/gridRows;
+
+   for (int k = 0; k < K; k++)
+   {
+      SynthObject &o = objects[k];
+      double cx = (k % gridCols + 0.5)*cellW, cy = (k / gridCols + 0.5)*cellH;
+      double radius = 0.5*sqrt(o.size.width*o.size.width + o.size.height*o.size.height);
+      double mx = max(0.0, 0.5*cellW - radius), my = max(0.0, 0.5*cellH - radius);
+
+      // bounce inside the cell
+      o.center = o.center + o.velocity;
+      if (fabs(o.center.x - cx) > mx || fabs(o.center.y - cy) > my)
+      {
+         o.velocity = o.velocity*(-1);
+         o.center = o.center + o.velocity*2;
+      }
+   }
+}
+
+void SynthScene::render(Mat &frame, bool withObjects)
+{
+   Point2f corners[4];
+   Point poly[4];
+
+   move();
+   background.copyTo(frame);
+
+   for (size_t k = 0; withObjects && k < objects.size(); k++)
+   {
+      RotatedRect(objects[k].center, objects[k].size, objects[k].angle).points(corners);
+      for (int j = 0; j < 4; j++)   // 4 bits of sub-pixel precision
+         poly[j] = Point(cvRound(corners[j].x*16), cvRound(corners[j].y*16));
+      fillConvexPoly(frame, poly, 4, palette[objects[k].colour], CV_AA, 4);
+   }
+
+   int length = cvRound(p.speed);
+   if (length > 1)   // motion blur along the direction of motion
+   {
+      Mat kernel = Mat::zeros(2*length + 1, 2*length + 1, CV_32FC1);
+      Point2f d = objects[0].velocity*(1.0/p.speed);
+      line(kernel, Point(cvRound(length - d.x*length/2), cvRound(length - d.y*length/2)),
+                   Point(cvRound(length + d.x*length/2), cvRound(length + d.y*length/2)), Scalar(1), 1, 8);
+      kernel = kernel*(1.0/sum(kernel)[0]);
+      filter2D(frame, frame, -1, kernel);
+   }
+
+   if (!shading.empty())
+      multiply(frame, shading, frame, 1.0/255);
+
+   if (p.blurKernel > 1)
+      GaussianBlur(frame, frame, Size(p.blurKernel | 1, p.blurKernel | 1), 0, 0);
+
+   if (p.noiseSigma > 0)
+   {
+      noise.create(frame.size(), CV_16SC3);
+      rng.fill(noise, RNG::NORMAL, Scalar::all(0), Scalar::all(p.noiseSigma));
+      add(frame, noise, frame, Mat(), CV_8U);
+   }
+}
+
+HSV** SynthScene::filters() const
+{
+   HSV** FiltersParams = AllocFilters(p.numColours);
+   int tolerance = min(20, max(3, (MAX_HUE + 1)/p.numColours/2 - 2));
+
+   for (int c = 0; c < p.numColours; c++)
+   {
+      FiltersParams[0][c].hue = max(0, hues[c] - tolerance);
+      FiltersParams[0][c].sat = SYNTH_SAT/2;
+      FiltersParams[0][c].val = SYNTH_VAL/4;
+      FiltersParams[1][c].hue = min(MAX_HUE, hues[c] + tolerance);
+      FiltersParams[1][c].sat = MAX_SAT;
+      FiltersParams[1][c].val = MAX_VAL;
+   }
+
+   return FiltersParams;
+}
@@ -0,0 +1,71 @@
+/*
+   Synthetic scenes with exact ground truth, used to benchmark the sensor (see bench.h).
+
+   A scene is made of K rotated rectangles painted in one of C well separated hues over a grey
+   background. Every call to render() moves the rectangles by their velocity and draws the next
+   frame, optionally degraded with motion blur, a lighting gradient, gaussian blur and noise.
+   Static clutter (strips of tape in the scene colours, never part of the ground truth) can be
+   painted on the background.
+*/
+
+#ifndef SYNTH_H
+#define SYNTH_H
+
+#include <vector>
+#include <opencv/highgui.h>
+#include <opencv/cv.h>
+#include "myLib.h"
+
+#define SYNTH_MAX_COLOURS 16
+
+struct SynthParams
+{
+   int width, height;
+   int numObjects;           // K
+   int numColours;           // C, at most SYNTH_MAX_COLOURS
+   double noiseSigma;        // standard deviation of the additive gaussian noise (grey levels)
+   int blurKernel;           // gaussian blur kernel size (0 = none)
+   double lighting;          // brightness drop across the frame, 0 = uniform, 0.5 = right side at half brightness
+   double speed;             // pixels per frame. Objects move and get a matching motion blur
+   int clutter;              // static strips in the colours of the objects, under them
+   unsigned int seed;
+
+   SynthParams() : width(FRAME_WIDTH), height(FRAME_HEIGHT), numObjects(1), numColours(1),
+                   noiseSigma(4), blurKernel(3), lighting(0.2), speed(0), clutter(0), seed(1) {}
+};
+
+struct SynthObject
+{
+   int colour;
+   cv::Point2f center;
+   cv::Size2f size;
+   float angle;              // degrees, as in cv::RotatedRect
+   cv::Point2f velocity;
+};
+
+class SynthScene
+{
+   public:
+      SynthScene(const SynthParams &params);
+
+      // draws the next frame (BGR) and updates the ground truth. Without objects only the (cluttered)
+      // background is drawn, e.g. for background models that learn on an empty scene
+      void render(cv::Mat &frame, bool withObjects = true);
+      const std::vector<SynthObject>& truth() const { return objects; }
+
+      // filters that separate the scene colours: FiltersParams[0][i] is the minimum for the i-th colour,
+      // FiltersParams[1][i] the maximum. Free them with FreeFilters() (see myLib.h)
+      HSV** filters() const;
+
+   private:
+      void move();
+
+      SynthParams p;
+      std::vector<SynthObject> objects;
+      std::vector<cv::Scalar> palette;   // BGR colour of each hue
+      std::vector<int> hues;
+      cv::Mat background, shading, noise;
+      cv::RNG rng;
+};
+
+#endif
@@ -0,0 +1,141 @@
+/*
+   Timeline tracing of the pipeline stages. See trace.h.
+*/
+
+#include <stdio.h>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include "trace.h"
+
+using namespace std;
+
+std::atomic<bool> traceEnabled(false);
+
+// One per thread. Only the owner thread writes 'events', head is published with release semantics
+// so that TraceWrite() sees complete events.
+struct TraceBuffer
+{
+   TraceEvent events[TRACE_EVENTS_PER_THREAD];
+   std::atomic<uint64_t> head;
+   int tid;
+   const char* name;
+};
+
+static std::mutex registryMutex;                 // taken once per thread (first span) and by TraceWrite()
+static std::vector<TraceBuffer*> registry;       // buffers are never freed: a thread may still be running
+static int64_t origin = 0;
+
+static thread_local TraceBuffer* localBuffer = NULL;
+static thread_local int64_t localFrame = -1;
+static thread_local const char* localName = NULL;
+
+int64_t TraceNow()
+{
+   return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static TraceBuffer* GetBuffer()
+{
+   if (localBuffer == NULL)
+   {
+      TraceBuffer* buffer = new TraceBuffer;
+
+      buffer->head.store(0);
+      buffer->name = localName;
+
+      lock_guard<mutex> lock(registryMutex);
+      buffer->tid = registry.size() + 1;
+      registry.push_back(buffer);
+      localBuffer = buffer;
+   }
+
+   return localBuffer;
+}
+
+void TraceStart()
+{
+   lock_guard<mutex> lock(registryMutex);
+
+   for (size_t i = 0; i < registry.size(); i++)   // forget the spans of a previous session
+      registry[i]->head.store(0);
+
+   origin = TraceNow();
+   traceEnabled.store(true);
+}
+
+void TraceStop()
+{
+   traceEnabled.store(false);
+}
+
+void TraceSetFrame(int64_t frameId)
+{
+   localFrame = frameId;
+}
+
+void TraceSetThreadName(const char* name)
+{
+   localName = name;
+   if (localBuffer != NULL)
+      localBuffer->name = name;
+}
+
+void TraceAppend(const char* name, int64_t begin, int64_t end, int colour)
+{
+   TraceBuffer* buffer = GetBuffer();
+   uint64_t h = buffer->head.load(memory_order_relaxed);
+   TraceEvent &e = buffer->events[h % TRACE_EVENTS_PER_THREAD];
+
+   e.name    = name;
+   e.begin   = begin;
+   e.end     = end;
+   e.frameId = (int32_t)localFrame;
+   e.colour  = colour;
+
+   buffer->head.store(h + 1, memory_order_release);
+}
+
+bool TraceWrite(const char* path)
+{
+   FILE* file = fopen(path, "w");
+   bool first = true;
+
+   if (file == NULL)
+      return false;
+
+   lock_guard<mutex> lock(registryMutex);
+
+   fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+   for (size_t t = 0; t < registry.size(); t++)
+   {
+      TraceBuffer* buffer = registry[t];
+      uint64_t h = buffer->head.load(memory_order_acquire);
+      // when the ring has wrapped, skip the oldest slot too: a span still in flight may be overwriting it
+      uint64_t from = h > TRACE_EVENTS_PER_THREAD ? h - TRACE_EVENTS_PER_THREAD + 1 : 0;
+
+      if (buffer->name != NULL)
+      {
+         fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                 first ? "" : ",\n", buffer->tid, buffer->name);
+         first = false;
+      }
+
+      for (uint64_t k = from; k < h; k++)
+      {
+         const TraceEvent &e = buffer->events[k % TRACE_EVENTS_PER_THREAD];
+
+         fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%lld,"
+                       "\"args\":{\"frame\":%d,\"colour\":%d}}",
+                 first ? "" : ",\n", e.name, buffer->tid, (long long)(e.begin - origin),
+                 (long long)(e.end - e.begin), e.frameId, e.colour);
+         first = false;
+      }
+   }
+
+   fprintf(file, "\n]}\n");
+   fclose(file);
+
+   return true;
+}
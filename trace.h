@@ -0,0 +1,81 @@
+/*
+   Timeline tracing of the pipeline stages, exported as Chrome trace-event JSON
+   (open it with chrome://tracing or https://ui.perfetto.dev).
+
+   Every thread appends its spans (stage name, begin/end, frame id, colour index) to its own
+   fixed size ring buffer: no locks and no allocations while tracing, memory bounded by
+   TRACE_EVENTS_PER_THREAD per thread, the oldest spans are overwritten first. When tracing is
+   off a span costs one relaxed atomic load.
+
+      TraceStart();
+      ...
+      TraceSetFrame(frameId);                // once per frame, on each thread working on it
+      {
+         TRACE_SPAN("inRange", i);           // colour index, -1 if the stage is not per colour
+         ...
+      }
+      ...
+      TraceStop();
+      TraceWrite("trace.json");
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#define TRACE_EVENTS_PER_THREAD  (1 << 16)   // 32 bytes each: 2MB per traced thread
+
+struct TraceEvent
+{
+   const char* name;     // must be a string literal (only the pointer is stored)
+   int64_t begin, end;   // microseconds
+   int32_t frameId;
+   int32_t colour;
+};
+
+extern std::atomic<bool> traceEnabled;
+
+void TraceStart();
+void TraceStop();
+// writes all the buffered spans. Call it after TraceStop()
+bool TraceWrite(const char* path);
+
+void TraceSetFrame(int64_t frameId);         // frame the calling thread is working on
+void TraceSetThreadName(const char* name);   // shown by the viewer instead of the thread id
+void TraceAppend(const char* name, int64_t begin, int64_t end, int colour);
+
+int64_t TraceNow();
+
+class TraceSpan
+{
+   public:
+      TraceSpan(const char* name, int colour = -1) : name(NULL)
+      {
+         if ( traceEnabled.load(std::memory_order_relaxed) )
+         {
+            this->name   = name;
+            this->colour = colour;
+            begin = TraceNow();
+         }
+      }
+
+      ~TraceSpan()
+      {
+         if (name != NULL)
+            TraceAppend(name, begin, TraceNow(), colour);
+      }
+
+   private:
+      const char* name;
+      int colour;
+      int64_t begin;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SPAN(...) TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(__VA_ARGS__)
+
+#endif
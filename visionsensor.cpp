@@ -0,0 +1,309 @@
+/*
+   The sensor as a library. See visionsensor.h.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <chrono>
+#include "visionsensor.h"
+#include "record.h"
+#include "trace.h"
+#include "bgmodel.h"
+#include "kernels.h"
+
+using namespace std;
+using namespace cv;
+
+#define SENSOR_FRESH 4   // flag in VisionSensor::latest, above the buffer indices
+
+VisionSensor::VisionSensor(void) : callback(NULL), user(NULL), active(false), stopRequested(false), latest(2), back(1),
+                                   front(0)
+{
+   memset(buffers, 0, sizeof(buffers));
+}
+
+VisionSensor::~VisionSensor(void)
+{
+   stop();
+}
+
+//*********************************************************************************************************************
+bool VisionSensor::configure(const SensorConfig &config)
+{
+   if ( running() || worker.joinable() )
+      return false;
+   if ( config.FiltersParams == NULL || config.HowManyColours <= 0 || config.HowManyColours > SENSOR_MAX_COLOURS ||
+        !config.params.valid() )
+      return false;
+
+   calibration = CameraCalibration();
+   if ( config.worldPath != NULL && !calibration.load(config.worldPath) )
+      return false;
+
+   live.reset();   // the number of colours may change here
+   live.publish(config.FiltersParams, config.HowManyColours, config.params, config.yuv);
+
+   this->config = config;
+   this->config.FiltersParams = NULL;
+
+   return true;
+}
+
+bool VisionSensor::update(HSV** FiltersParams, const DetectParams &params)
+{
+   if ( FiltersParams == NULL )
+      return live.publishParams(params);
+   return live.publish(FiltersParams, config.HowManyColours, params);
+}
+
+void VisionSensor::setCallback(SensorCallback callback, void* user)
+{
+   if ( running() || worker.joinable() )
+      return;
+
+   this->callback = callback;
+   this->user = user;
+}
+//*********************************************************************************************************************
+
+//*********************************************************************************************************************
+bool VisionSensor::start()
+{
+   if ( live.generation() == 0 || running() )
+      return false;
+   if ( worker.joinable() )   // the source ended on its own
+      worker.join();
+
+   if ( (config.watchPath != NULL || config.controlPort > 0) &&
+        !watcher.start(live, config.watchPath, config.controlPort, false, config.controlAddress) )
+      return false;
+
+   if ( config.source != NULL )
+      capture.open(config.source);
+   else
+      capture.open(config.camera);
+   if ( !capture.isOpened() )
+   {
+      watcher.stop();
+      return false;
+   }
+
+   if ( config.source == NULL )
+   {
+      capture.set(CV_CAP_PROP_FRAME_WIDTH,  config.size.width);
+      capture.set(CV_CAP_PROP_FRAME_HEIGHT, config.size.height);
+      if ( config.yuv )   // same as SensingMode(): BGR frames are handled anyway if the backend ignores us
+      {
+         capture.set(CV_CAP_PROP_FOURCC, CV_FOURCC('Y','U','Y','V'));
+         capture.set(CV_CAP_PROP_CONVERT_RGB, 0);
+      }
+   }
+
+   // what the camera accepted, not what was asked: the layout of the raw YUV frames depends on it
+   frameSize = Size((int)capture.get(CV_CAP_PROP_FRAME_WIDTH), (int)capture.get(CV_CAP_PROP_FRAME_HEIGHT));
+   if ( frameSize.area() <= 0 )
+      frameSize = config.size;
+   failure.clear();
+
+   stopRequested.store(false);
+   active.store(true, memory_order_release);
+   worker = thread(&VisionSensor::run, this);
+
+   return true;
+}
+
+void VisionSensor::stop()
+{
+   stopRequested.store(true);
+   if ( worker.joinable() )
+      worker.join();
+   watcher.stop();
+   active.store(false, memory_order_release);
+   capture.release();
+}
+//*********************************************************************************************************************
+
+//*********************************************************************************************************************
+const DetectionFrame& VisionSensor::poll()
+{
+   // swap our buffer with the published one only if it is newer: a single atomic exchange, no waiting
+   if ( latest.load(memory_order_acquire) & SENSOR_FRESH )
+      front = latest.exchange(front, memory_order_acq_rel) & ~SENSOR_FRESH;
+
+   return buffers[front];
+}
+
+void VisionSensor::publish(uint64_t frameId, int64_t timestampUs, const vector<Object> targets[])
+{
+   DetectionFrame &out = buffers[back];
+
+   out.frameId     = frameId;
+   out.timestampUs = timestampUs;
+   out.count       = 0;
+   out.truncated   = 0;
+
+   for (int i = 0; i < config.HowManyColours; i++)
+      for (size_t j = 0; j < targets[i].size(); j++)
+      {
+         if (out.count == SENSOR_MAX_DETECTIONS)
+         {
+            out.truncated = 1;
+            break;
+         }
+
+         const Object &o = targets[i][j];
+         Detection &d = out.items[out.count];
+
+         d.colour = i;
+         d.x      = o.getCenter().x;
+         d.y      = o.getCenter().y;
+         d.angle  = o.getAngle();
+         d.width  = o.getSize().width;
+         d.height = o.getSize().height;
+         d.shape  = o.getShape();
+         d.shapeConfidence = o.getShapeConfidence();
+         d.mapped = o.isMapped();
+         d.worldX = o.getWorldCenter().x;
+         d.worldY = o.getWorldCenter().y;
+         d.worldAngle = o.isMapped() ? o.getWorldAngle() : 0;
+         out.count++;
+      }
+
+   out.publishedUs = NowMicroseconds();
+
+   // the filled buffer becomes the latest, we get back the one it replaces (or the reader's old one)
+   back = latest.exchange(back | SENSOR_FRESH, memory_order_acq_rel) & ~SENSOR_FRESH;
+
+   if (callback != NULL)
+      callback(out, user);
+}
+//*********************************************************************************************************************
+
+//*********************************************************************************************************************
+void VisionSensor::run()
+{
+   int N = config.HowManyColours;   // can't change while running
+   vector<Object> targets[N];
+   DetectWorkspace workspace;
+   BackgroundModel background;
+   vector<uint64_t> filterGenerations;   // of the last snapshot, to relearn the colours changed since
+   vector<Mat> masks;
+   YUVFormat format;
+   Mat raw, view, bgr;
+   int64_t timestamp;
+   int reader = live.attach();
+   const ConfigSnapshot* snapshot;
+   bool yuvFrame;
+
+   TraceSetThreadName("vision sensor");
+   if ( config.background )
+      workspace.background = &background;
+
+   // an exception must not reach the host: the worker stops and error() tells why
+   try
+   {
+      for (uint64_t frameId = 1; !stopRequested.load(memory_order_relaxed); frameId++)
+      {
+         TraceSetFrame(frameId);
+
+         {
+            TRACE_SPAN("capture");
+            if ( !capture.read(raw) || raw.empty() )
+               break;
+            timestamp = NowMicroseconds();
+         }
+
+         // the configuration of this frame: what was published meanwhile is taken here, all at once
+         snapshot = live.acquire(reader);
+         workspace.params = snapshot->params;
+         FollowFilterChanges(snapshot, filterGenerations, background);
+
+         yuvFrame = snapshot->yuv && GuessYUVLayout(raw, frameSize, format, view);
+         if ( yuvFrame && !snapshot->classifier.empty() )
+            DetectObjectsYUV(view, format, frameSize, snapshot->classifier, masks, targets, workspace.background,
+                             snapshot->params);
+         else if ( yuvFrame )   // too many colours for the lookup table
+         {
+            YUVToBGR(view, format, bgr);
+            DetectObjects(bgr, snapshot->FiltersParams, N, targets, workspace);
+         }
+         else if ( raw.type() == CV_8UC3 )
+            DetectObjects(raw, snapshot->FiltersParams, N, targets, workspace);
+         else
+         {
+            char text[128];
+            snprintf(text, sizeof(text), "unexpected frame: %dx%d, type %d, while expecting %dx%d", raw.cols, raw.rows,
+                     raw.type(), frameSize.width, frameSize.height);
+            failure = text;
+            break;
+         }
+
+         if ( !calibration.empty() )
+         {
+            TRACE_SPAN("toWorld");
+            calibration.mapObjects(targets, N);
+         }
+
+         TRACE_SPAN("publish");
+         publish(frameId, timestamp, targets);
+      }
+   }
+   catch (const std::exception &e)   // cv::Exception included
+   {
+      failure = e.what();
+   }
+
+   live.detach(reader);
+   active.store(false, memory_order_release);
+}
+//*********************************************************************************************************************
+
+//*********************************************************************************************************************
+void SensorMode(const SensorConfig &config, double rate)
+{
+   VisionSensor sensor;
+   uint64_t last = 0;
+   int64_t period = (int64_t)(1e6/max(rate, 1.0));
+
+   if ( !sensor.configure(config) || !sensor.start() )
+   {
+      cout << "Not able to start the sensor." << endl;
+      return;
+   }
+   cout << "Classification of the BGR frames: " << DescribeHSVKernel(config.HowManyColours) << "." << endl;
+
+   // the control loop of the robot would be here
+   for (int64_t next = NowMicroseconds(); ; next += period)
+   {
+      bool alive = sensor.running();   // checked first, so that the last result is not missed
+      const DetectionFrame &frame = sensor.poll();
+
+      if (frame.frameId != last)
+      {
+         cout << "frame " << frame.frameId << ", " << frame.count << " objects, "
+              << (NowMicroseconds() - frame.timestampUs)/1000.0 << " ms old" << endl;
+         for (int k = 0; k < frame.count; k++)
+         {
+            const Detection &d = frame.items[k];
+
+            cout << "   colour " << d.colour << " at (" << d.x << ", " << d.y << ") angle " << d.angle;
+            if (d.mapped)
+               cout << ", (" << d.worldX << ", " << d.worldY << ") mm angle " << d.worldAngle;
+            cout << endl;
+         }
+         last = frame.frameId;
+      }
+
+      if (!alive)
+         break;
+      this_thread::sleep_for( chrono::microseconds(max((int64_t)0, next - NowMicroseconds())) );
+   }
+
+   if ( !sensor.error().empty() )
+      cout << "The sensor stopped: " << sensor.error() << endl;
+
+   sensor.stop();
+   return;
+}
+//*********************************************************************************************************************
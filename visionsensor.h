@@ -0,0 +1,151 @@
+/*
+   The sensor as a library, to be embedded in the robot controller instead of running as a separate
+   process: no windows, no keyboard, no printing.
+
+      VisionSensor sensor;
+      SensorConfig config;
+
+      config.FiltersParams  = LoadFilters("filters.yml", config.HowManyColours);
+      sensor.configure(config);              // the filters are copied
+      sensor.start();                        // opens the camera and starts the worker thread
+      ...
+      const DetectionFrame &latest = sensor.poll();   // from the control loop, as often as needed
+      for (int k = 0; k < latest.count; k++)
+         ... latest.items[k] ...
+      ...
+      sensor.stop();
+
+   The worker thread captures and processes the frames and publishes every result through a triple
+   buffer: poll() never blocks, never allocates and never copies, it returns the newest complete
+   result (the same one again if nothing newer has been published, check frameId). The result stays
+   valid and unchanged until the next call to poll(). There must be only one reader thread.
+
+   A callback can be set as well: it is called on the worker thread right after each publication, so
+   it has to be quick.
+
+   The filters and the DetectParams can be changed while running, with update() or from outside through
+   SensorConfig::watchPath and controlPort: the worker takes the change at the start of the next frame
+   (see liveconfig.h).
+*/
+
+#ifndef VISIONSENSOR_H
+#define VISIONSENSOR_H
+
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <opencv/highgui.h>
+#include <opencv/cv.h>
+#include "myLib.h"
+#include "yuv.h"
+#include "calib.h"
+#include "liveconfig.h"
+
+#define SENSOR_MAX_COLOURS     YUV_MAX_COLOURS
+#define SENSOR_MAX_DETECTIONS  (MAX_NUM_OBJECTS*SENSOR_MAX_COLOURS)   // analyzeContours() keeps less than
+                                                                      // MAX_NUM_OBJECTS per colour by default
+                                                                      // (DetectParams::maxObjects)
+struct Detection
+{
+   int32_t colour;          // index of the filter
+   float   x, y;            // sub-pixel center, pixels
+   float   angle;           // degrees, as in cv::RotatedRect
+   float   width, height;
+   int32_t shape;           // ObjectShape
+   float   shapeConfidence;
+   int32_t mapped;          // 1 if the world fields are valid (SensorConfig::worldPath)
+   float   worldX, worldY;  // millimetres on the work plane
+   float   worldAngle;
+};
+
+struct DetectionFrame
+{
+   uint64_t frameId;        // 0 until the first frame is published, then 1, 2, ...
+   int64_t  timestampUs;    // capture time (NowMicroseconds(), see record.h)
+   int64_t  publishedUs;    // when the result was published
+   int32_t  count;
+   int32_t  truncated;      // 1 if some objects did not fit in items[]
+   Detection items[SENSOR_MAX_DETECTIONS];
+};
+
+struct SensorConfig
+{
+   int camera;                // VideoCapture index
+   const char* source;        // video file or image sequence instead of the camera
+   cv::Size size;             // requested frame size
+   HSV** FiltersParams;       // copied by configure()
+   int HowManyColours;
+   DetectParams params;
+   bool yuv;                  // raw YUYV/NV12 frames classified without conversions (see yuv.h)
+   bool background;           // ignore the static clutter (see bgmodel.h)
+   const char* worldPath;     // calibration saved by -CALIBRATE (see calib.h)
+   const char* watchPath;     // filters file loaded again whenever it changes (see liveconfig.h)
+   int controlPort;           // UDP port taking filter and parameter updates, 0 for none (see liveconfig.h)
+   const char* controlAddress;   // IPv4 address the control port is bound to, NULL for the loopback only
+
+   SensorConfig() : camera(0), source(NULL), size(FRAME_WIDTH, FRAME_HEIGHT), FiltersParams(NULL), HowManyColours(0),
+                    yuv(false), background(false), worldPath(NULL), watchPath(NULL), controlPort(0),
+                    controlAddress(NULL) {}
+};
+
+typedef void (*SensorCallback)(const DetectionFrame &frame, void* user);
+
+class VisionSensor
+{
+   public:
+      VisionSensor(void);
+      ~VisionSensor(void);
+
+      // only while stopped. Fails if the filters are missing, there are more than SENSOR_MAX_COLOURS
+      // colours, the params are invalid or the calibration can't be loaded
+      bool configure(const SensorConfig &config);
+      // any time, from any thread: new filters (NULL keeps them, same number of colours) and params.
+      // The lookup table of the YUV path is built in the calling thread
+      bool update(HSV** FiltersParams, const DetectParams &params);
+      // only while stopped. NULL removes it
+      void setCallback(SensorCallback callback, void* user);
+
+      // opens the source and starts the worker thread. Fails if the source can't be opened or the
+      // control port can't be bound
+      bool start();
+      // stops the worker thread and closes the source. The last result can still be polled
+      void stop();
+      // false once stopped, when the source ended or after an error
+      bool running() const { return active.load(std::memory_order_acquire); }
+      // why the worker stopped on its own, empty if it did not (or is still running)
+      std::string error() const { return running() ? std::string() : failure; }
+
+      // wait-free, single reader: see above
+      const DetectionFrame& poll();
+
+   private:
+      void run();
+      void publish(uint64_t frameId, int64_t timestampUs, const std::vector<Object> targets[]);
+
+      SensorConfig config;       // without the filters, they are in 'live'
+      LiveConfig live;
+      ConfigWatcher watcher;
+      CameraCalibration calibration;
+      cv::VideoCapture capture;
+      cv::Size frameSize;        // as reported by the capture once opened
+      std::string failure;       // written by the worker before it clears 'active'
+
+      SensorCallback callback;
+      void* user;
+
+      std::thread worker;
+      std::atomic<bool> active, stopRequested;
+
+      // triple buffer: the worker fills buffers[back], the reader owns buffers[front], 'latest' holds the
+      // index of the third one plus SENSOR_FRESH when it is newer than what the reader has
+      DetectionFrame buffers[3];
+      std::atomic<int> latest;
+      int back, front;
+};
+
+// Example of use: runs the sensor and polls it 'rate' times per second from this thread, printing
+// every new result, until the source ends
+void SensorMode(const SensorConfig &config, double rate);
+
+#endif
@@ -0,0 +1,288 @@
+/*
+   Colour classification straight from YUV frames. See yuv.h.
+*/
+
+#include <stdio.h>
+#include <iostream>
+#include "yuv.h"
+#include "record.h"
+#include "trace.h"
+#include "kernels.h"
+#include "bgmodel.h"
+
+using namespace std;
+using namespace cv;
+
+YUVClassifier::YUVClassifier(void) : numColours(0)
+{
+}
+
+//*********************************************************************************************************************
+bool YUVClassifier::build(HSV** FiltersParams, int HowManyColours)
+{
+   const int cells  = 1 << (YUV_Y_BITS + 2*YUV_UV_BITS);
+   const int width  = 1 << 10;                // macropixels per row of the calibration image
+   const int height = cells/width;
+   Mat yuyv(height, 2*width, CV_8UC2), bgr, hsv;
+
+   lut.clear();
+   numColours = 0;
+   if (HowManyColours > YUV_MAX_COLOURS)
+      return false;
+
+   // One YUYV macropixel (2 pixels with the same Y) per cell, at the center of the cell
+   for (int r = 0; r < height; r++)
+   {
+      uchar* row = yuyv.ptr<uchar>(r);
+
+      for (int m = 0; m < width; m++)
+      {
+         int cell = r*width + m;
+         int y = cell >> (2*YUV_UV_BITS), u = (cell >> YUV_UV_BITS) & ((1 << YUV_UV_BITS) - 1), v = cell & ((1 << YUV_UV_BITS) - 1);
+
+         y = (y << (8 - YUV_Y_BITS))  | (1 << (7 - YUV_Y_BITS));
+         u = (u << (8 - YUV_UV_BITS)) | (1 << (7 - YUV_UV_BITS));
+         v = (v << (8 - YUV_UV_BITS)) | (1 << (7 - YUV_UV_BITS));
+
+         row[4*m] = y;  row[4*m + 1] = u;  row[4*m + 2] = y;  row[4*m + 3] = v;
+      }
+   }
+
+   // same conversions as the reference path
+   cvtColor(yuyv, bgr, CV_YUV2BGR_YUYV);
+   cvtColor(bgr, hsv, CV_BGR2HSV);
+
+   lut.resize(cells);
+   for (int r = 0; r < height; r++)
+   {
+      const uchar* row = hsv.ptr<uchar>(r);
+
+      for (int m = 0; m < width; m++)
+      {
+         const uchar* px = row + 6*m;   // first pixel of the macropixel
+         uint16_t bits = 0;
+
+         for (int i = 0; i < HowManyColours; i++)
+            if (px[0] >= FiltersParams[0][i].hue && px[0] <= FiltersParams[1][i].hue &&
+                px[1] >= FiltersParams[0][i].sat && px[1] <= FiltersParams[1][i].sat &&
+                px[2] >= FiltersParams[0][i].val && px[2] <= FiltersParams[1][i].val)
+               bits |= 1 << i;
+
+         lut[r*width + m] = bits;
+      }
+   }
+
+   numColours = HowManyColours;
+   return true;
+}
+//*********************************************************************************************************************
+
+//*********************************************************************************************************************
+void YUVClassifier::classify(const Mat &raw, YUVFormat format, Size size, vector<Mat> &masks) const
+{
+   YUVKernel kernel = SelectYUVKernel(numColours, format, MASK_SEPARATE);
+   vector<uchar*> out(numColours);
+
+   masks.resize(numColours);
+   if (kernel != NULL)   // specialised on the number of colours (see kernels.h)
+   {
+      kernel(raw, size, *this, &masks[0]);
+      return;
+   }
+
+   for (int i = 0; i < numColours; i++)
+      masks[i].create(size, CV_8UC1);
+
+   for (int r = 0; r < size.height; r++)
+   {
+      for (int i = 0; i < numColours; i++)
+         out[i] = masks[i].ptr<uchar>(r);
+
+      // two pixels at a time: they share the same chroma in both formats
+      if (format == YUV_FORMAT_YUYV)
+      {
+         const uchar* p = raw.ptr<uchar>(r);   // Y0 U Y1 V
+
+         for (int x = 0; x < size.width; x += 2, p += 4)
+            store(out, x, lookup(p[0], p[1], p[3]), lookup(p[2], p[1], p[3]));
+      }
+      else
+      {
+         const uchar* py  = raw.ptr<uchar>(r);                   // Y plane
+         const uchar* puv = raw.ptr<uchar>(size.height + r/2);   // interleaved UV, one row every two
+
+         for (int x = 0; x < size.width; x += 2)
+            store(out, x, lookup(py[x], puv[x], puv[x + 1]), lookup(py[x + 1], puv[x], puv[x + 1]));
+      }
+   }
+}
+//*********************************************************************************************************************
+
+//*********************************************************************************************************************
+void DetectObjectsYUV(const Mat &raw, YUVFormat format, Size size, const YUVClassifier &classifier,
+                      vector<Mat> &masks, vector<Object> targets[], BackgroundModel* background,
+                      const DetectParams &params)
+{
+   TRACE_SPAN("DetectObjectsYUV");
+
+   {
+      TRACE_SPAN("classifyYUV");
+      classifier.classify(raw, format, size, masks);
+   }
+
+   if (background != NULL)
+      background->beginFrame(size, classifier.colours());
+
+   for (int i = 0; i < classifier.colours(); i++)
+   {
+      if (background != NULL)
+      {
+         TRACE_SPAN("background", i);
+         background->apply(i, masks[i]);
+      }
+
+      TRACE_SPAN("analyzeMask", i);
+      targets[i] = analyzeMask(masks[i], params);
+   }
+
+   return;
+}
+//*********************************************************************************************************************
+
+//*********************************************************************************************************************
+bool GuessYUVLayout(const Mat &raw, Size expected, YUVFormat &format, Mat &view)
+{
+   size_t pixels = (size_t)expected.width*expected.height;
+
+   if (raw.type() == CV_8UC2 && raw.cols == expected.width && raw.rows == expected.height)
+   {
+      format = YUV_FORMAT_YUYV;
+      view = raw;
+      return true;
+   }
+
+   if (raw.type() != CV_8UC1 || !raw.isContinuous())
+      return false;
+
+   // some backends hand out the whole buffer as a single row of bytes
+   if (raw.total() == 2*pixels)
+   {
+      format = YUV_FORMAT_YUYV;
+      view = raw.reshape(2, expected.height);
+      return true;
+   }
+   if (raw.total() == pixels*3/2)
+   {
+      format = YUV_FORMAT_NV12;
+      view = raw.reshape(1, expected.height*3/2);
+      return true;
+   }
+
+   return false;
+}
+
+void YUVToBGR(const Mat &raw, YUVFormat format, Mat &bgr)
+{
+   cvtColor(raw, bgr, format == YUV_FORMAT_YUYV ? CV_YUV2BGR_YUYV : CV_YUV2BGR_NV12);
+}
+//*********************************************************************************************************************
+
+//*********************************************************************************************************************
+void YUVTestMode(const char* path, Size size, YUVFormat format, HSV** FiltersParams, int HowManyColours)
+{
+   YUVClassifier classifier;
+   Mat raw, bgr, hsv;
+   vector<Mat> refMasks(HowManyColours), yuvMasks;
+   vector<Object> refTargets[HowManyColours], yuvTargets[HowManyColours];
+   int64_t refMaskTime = 0, refAnalysisTime = 0, yuvMaskTime = 0, yuvAnalysisTime = 0, t0, t1, t2;
+   double differentPixels = 0;
+   int frames = 0, matched = 0, refOnly = 0, yuvOnly = 0;
+   double maxError = 0;
+
+   if (format == YUV_FORMAT_YUYV)
+      raw.create(size.height, size.width, CV_8UC2);
+   else
+      raw.create(size.height*3/2, size.width, CV_8UC1);
+
+   FILE* file = fopen(path, "rb");
+   if (file == NULL)
+   {
+      cout << "Not able to open " << path << endl;
+      return;
+   }
+
+   t0 = NowMicroseconds();
+   if ( !classifier.build(FiltersParams, HowManyColours) )
+   {
+      cout << "The YUV path supports up to " << YUV_MAX_COLOURS << " colours." << endl;
+      fclose(file);
+      return;
+   }
+   cout << "Lookup table built in " << (NowMicroseconds() - t0)/1000.0 << " ms" << endl;
+
+   while ( fread(raw.data, 1, raw.total()*raw.elemSize(), file) == raw.total()*raw.elemSize() )
+   {
+      // reference: YUV -> BGR (what VideoCapture does) -> HSV -> inRange
+      t0 = NowMicroseconds();
+      YUVToBGR(raw, format, bgr);
+      cvtColor(bgr, hsv, CV_BGR2HSV);
+      for (int i = 0; i < HowManyColours; i++)
+         inRange(hsv, Scalar( FiltersParams[0][i].hue, FiltersParams[0][i].sat, FiltersParams[0][i].val ),
+            Scalar( FiltersParams[1][i].hue, FiltersParams[1][i].sat, FiltersParams[1][i].val ), refMasks[i] );
+      t1 = NowMicroseconds();
+      refMaskTime += t1 - t0;
+
+      // YUV path
+      classifier.classify(raw, format, size, yuvMasks);
+      t2 = NowMicroseconds();
+      yuvMaskTime += t2 - t1;
+
+      for (int i = 0; i < HowManyColours; i++)
+      {
+         Mat diff;
+         bitwise_xor(refMasks[i], yuvMasks[i], diff);
+         differentPixels += countNonZero(diff);
+      }
+
+      // the analysis is the same for both, it is timed to show the share of the classification
+      t0 = NowMicroseconds();
+      for (int i = 0; i < HowManyColours; i++)
+         refTargets[i] = analyzeMask(refMasks[i]);
+      t1 = NowMicroseconds();
+      for (int i = 0; i < HowManyColours; i++)
+         yuvTargets[i] = analyzeMask(yuvMasks[i]);
+      t2 = NowMicroseconds();
+      refAnalysisTime += t1 - t0;
+      yuvAnalysisTime += t2 - t1;
+
+      for (int i = 0; i < HowManyColours; i++)
+      {
+         int m = MatchObjects(refTargets[i], yuvTargets[i], 2.0, &maxError);
+         matched += m;
+         refOnly += refTargets[i].size() - m;
+         yuvOnly += yuvTargets[i].size() - m;
+      }
+
+      frames++;
+   }
+   fclose(file);
+
+   if (frames == 0)
+   {
+      cout << "No complete frame in " << path << endl;
+      return;
+   }
+
+   cout << frames << " frames" << endl;
+   cout << "Classification per frame: HSV path " << refMaskTime/1000.0/frames << " ms, YUV path "
+        << yuvMaskTime/1000.0/frames << " ms" << endl;
+   cout << "Blob analysis per frame:  HSV path " << refAnalysisTime/1000.0/frames << " ms, YUV path "
+        << yuvAnalysisTime/1000.0/frames << " ms" << endl;
+   cout << "Pixels classified differently: "
+        << 100.0*differentPixels/((double)frames*HowManyColours*size.area()) << " %" << endl;
+   cout << "Objects: " << matched << " in both (max center error " << maxError << " px), "
+        << refOnly << " only in the HSV path, " << yuvOnly << " only in the YUV path" << endl;
+
+   return;
+}
+//*********************************************************************************************************************
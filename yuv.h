@@ -0,0 +1,87 @@
+/*
+   Colour classification straight from the YUV frames delivered by V4L2 cameras (Pi camera included).
+
+   The usual path converts YUV to BGR (inside VideoCapture) and then BGR to HSV before thresholding.
+   Here the HSV filters are translated once into a lookup table indexed by the quantized (Y, U, V)
+   triplet: each entry holds one bit per colour, set when that YUV value falls inside the colour's HSV
+   box. Classifying a pixel is then a single table lookup, with no colour conversion at all.
+
+   The table is built by pushing every (Y, U, V) cell through the very same conversions used by the
+   reference path (YUV -> BGR -> HSV), so the two paths only differ because of the quantization
+   (Y on 6 bits, U and V on 7 bits).
+*/
+
+#ifndef YUV_H
+#define YUV_H
+
+#include <stdint.h>
+#include <vector>
+#include <opencv/highgui.h>
+#include <opencv/cv.h>
+#include "myLib.h"
+
+#define YUV_Y_BITS   6
+#define YUV_UV_BITS  7
+#define YUV_MAX_COLOURS 16   // one bit per colour in a uint16_t
+
+enum YUVFormat
+{
+   YUV_FORMAT_YUYV,   // packed 4:2:2, Y0 U Y1 V. Mat of rows x cols CV_8UC2
+   YUV_FORMAT_NV12    // planar 4:2:0, Y plane followed by interleaved UV. Mat of rows*3/2 x cols CV_8UC1
+};
+
+class YUVClassifier
+{
+   public:
+      YUVClassifier(void);
+
+      // translates the HSV filters in the lookup table. Fails if there are more than YUV_MAX_COLOURS colours
+      bool build(HSV** FiltersParams, int HowManyColours);
+      bool empty() const { return lut.empty(); }
+      int colours() const { return numColours; }
+
+      // masks[i] receives the binary image (0/255) of the i-th colour. 'raw' is laid out as described
+      // by 'format', 'size' is the size of the image
+      void classify(const cv::Mat &raw, YUVFormat format, cv::Size size, std::vector<cv::Mat> &masks) const;
+
+      uint16_t lookup(int y, int u, int v) const
+      {
+         return lut[ ((y >> (8 - YUV_Y_BITS)) << (2*YUV_UV_BITS)) | ((u >> (8 - YUV_UV_BITS)) << YUV_UV_BITS) |
+                     (v >> (8 - YUV_UV_BITS)) ];
+      }
+
+   private:
+      // expands the colour bits of two neighbouring pixels in the masks
+      void store(std::vector<uchar*> &out, int x, uint16_t b0, uint16_t b1) const
+      {
+         for (int i = 0; i < numColours; i++)
+         {
+            out[i][x]     = (uchar)(0 - ((b0 >> i) & 1));
+            out[i][x + 1] = (uchar)(0 - ((b1 >> i) & 1));
+         }
+      }
+
+      std::vector<uint16_t> lut;
+      int numColours;
+};
+
+class BackgroundModel;
+
+// Same as DetectObjects() but starting from a raw YUV frame, classified by 'classifier'.
+// 'background' is optional (see bgmodel.h), 'params' go to analyzeMask()
+void DetectObjectsYUV(const cv::Mat &raw, YUVFormat format, cv::Size size, const YUVClassifier &classifier,
+                      std::vector<cv::Mat> &masks, vector<Object> targets[], BackgroundModel* background = NULL,
+                      const DetectParams &params = DetectParams());
+
+// Guesses the layout of a raw frame coming from VideoCapture with CV_CAP_PROP_CONVERT_RGB disabled.
+// Returns false if the frame is not YUV (e.g. the backend ignored the property and converted it anyway)
+bool GuessYUVLayout(const cv::Mat &raw, cv::Size expected, YUVFormat &format, cv::Mat &view);
+
+// Reference converting a raw YUV frame to BGR, as VideoCapture would
+void YUVToBGR(const cv::Mat &raw, YUVFormat format, cv::Mat &bgr);
+
+// Compares the YUV path with the HSV one on a raw YUV file (frames of 'size' stored back to back),
+// reporting the accuracy parity and the per-frame cost of both
+void YUVTestMode(const char* path, cv::Size size, YUVFormat format, HSV** FiltersParams, int HowManyColours);
+
+#endif